@@ -0,0 +1,267 @@
+#include <Autotuner.h>
+
+#include <StreamCoder.h>
+#include <Implementations/Hilbert.h>
+#include <Implementations/Hue.h>
+#include <Implementations/Morton.h>
+#include <Implementations/Packed2.h>
+#include <Implementations/Packed3.h>
+#include <Implementations/Phase.h>
+#include <Implementations/Split2.h>
+#include <Implementations/Split3.h>
+#include <Implementations/Triangle.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+
+namespace DStream
+{
+	Autotuner::Autotuner() : candidates(DefaultCandidates())
+	{
+		encoder.setJpegColorSpace(JCS_RGB);
+		decoder.setJpegColorSpace(JCS_RGB);
+	}
+
+	std::vector<TileHeader> Autotuner::DefaultCandidates()
+	{
+		return {
+			TileHeader(CoderType::Packed2, 4),
+			TileHeader(CoderType::Hilbert, 5),
+			TileHeader(CoderType::Split2, 8),
+			TileHeader(CoderType::Phase, 8),
+			TileHeader(CoderType::Triangle, 8),
+			TileHeader(CoderType::Packed2, 6),
+			TileHeader(CoderType::Hilbert, 4),
+			TileHeader(CoderType::Hue, 8),
+		};
+	}
+
+	void Autotuner::setCandidates(const std::vector<TileHeader>& candidates)
+	{
+		this->candidates = candidates;
+	}
+
+	void Autotuner::setQuality(int quality)
+	{
+		this->quality = quality;
+	}
+
+	void Autotuner::setLambda(double lambda)
+	{
+		this->lambda = lambda;
+	}
+
+	void Autotuner::setTimeBudget(double ms)
+	{
+		timeBudget = ms;
+	}
+
+	void Autotuner::setMaxSamplePixels(uint32_t pixels)
+	{
+		maxSamplePixels = std::max<uint32_t>(1, pixels);
+	}
+
+	template <typename T>
+	void Autotuner::evaluate(const TileHeader& header, AutotuneEvaluation& result)
+	{
+		// Tables would take longer to build than the sample takes to code
+		StreamCoder<T> coder(header.Enlarge, header.Interpolate, header.AlgoBits, { 8, 8, 8 }, false);
+		uint32_t nElements = sampleWidth * sampleHeight;
+
+		coder.Encode((Color*)colors.data(), sample.data(), nElements);
+
+		uint8_t* jpeg = nullptr;
+		int length = 0, w, h;
+		encoder.setQuality(quality);
+		bool success = encoder.encode(colors.data(), sampleWidth, sampleHeight, jpeg, length) &&
+			decoder.decodeNonAlloc(jpeg, length, colors.data(), w, h);
+		free(jpeg);
+
+		// A candidate that can't go through the JPEG is never picked
+		if (!success)
+		{
+			result.Size = 0;
+			result.BitsPerPixel = INFINITY;
+			result.Rmse = INFINITY;
+			result.MaxError = 65535;
+			result.Cost = INFINITY;
+			return;
+		}
+
+		coder.Decode(decoded.data(), (Color*)colors.data(), nElements);
+
+		double squaredSum = 0;
+		uint32_t maxError = 0;
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			int error = std::abs((int)decoded[i] - (int)sample[i]);
+			squaredSum += (double)error * error;
+			maxError = std::max<uint32_t>(maxError, error);
+		}
+
+		result.Size = length;
+		result.BitsPerPixel = length * 8.0 / nElements;
+		result.Rmse = std::sqrt(squaredSum / nElements);
+		result.MaxError = maxError;
+		result.Cost = result.Rmse + lambda * result.BitsPerPixel;
+	}
+
+	TileHeader Autotuner::tune(const uint16_t* depth, int width, int height, int stride /* = 0*/)
+	{
+		if (stride == 0)
+			stride = width;
+
+		int step = std::max(1, (int)std::ceil(std::sqrt((double)width * height / maxSamplePixels)));
+		while (((width + step - 1) / step) * ((height + step - 1) / step) > (int)maxSamplePixels)
+			step++;
+		sampleWidth = (width + step - 1) / step;
+		sampleHeight = (height + step - 1) / step;
+		sample.resize(sampleWidth * sampleHeight);
+		decoded.resize(sample.size());
+		colors.resize(sample.size() * 3);
+
+		for (int y = 0; y < sampleHeight; y++)
+			for (int x = 0; x < sampleWidth; x++)
+				sample[y * sampleWidth + x] = depth[(size_t)y * step * stride + x * step];
+
+		evaluations.clear();
+		auto start = std::chrono::high_resolution_clock::now();
+		TileHeader best = candidates.empty() ? TileHeader() : candidates[0];
+		double bestCost = INFINITY;
+
+		for (const TileHeader& candidate : candidates)
+		{
+			auto now = std::chrono::high_resolution_clock::now();
+			if (!evaluations.empty() && timeBudget > 0 && std::chrono::duration<double, std::milli>(now - start).count() >= timeBudget)
+				break;
+
+			AutotuneEvaluation result;
+			result.Header = candidate;
+			switch (candidate.Coder)
+			{
+			case CoderType::Packed2: evaluate<Packed2>(candidate, result); break;
+			case CoderType::Packed3: evaluate<Packed3>(candidate, result); break;
+			case CoderType::Split2: evaluate<Split2>(candidate, result); break;
+			case CoderType::Split3: evaluate<Split3>(candidate, result); break;
+			case CoderType::Hilbert: evaluate<Hilbert>(candidate, result); break;
+			case CoderType::Morton: evaluate<Morton>(candidate, result); break;
+			case CoderType::Hue: evaluate<Hue>(candidate, result); break;
+			case CoderType::Triangle: evaluate<Triangle>(candidate, result); break;
+			case CoderType::Phase: evaluate<Phase>(candidate, result); break;
+			default: continue;
+			}
+			result.Ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - now).count();
+			evaluations.push_back(result);
+
+			if (result.Cost < bestCost)
+			{
+				bestCost = result.Cost;
+				best = candidate;
+			}
+		}
+
+		best.Quality = quality;
+		return best;
+	}
+
+	template <typename T>
+	void TiledCoder::MakeCoder(Coder& coder)
+	{
+		auto streamCoder = std::make_shared<StreamCoder<T>>(coder.Header.Enlarge, coder.Header.Interpolate, coder.Header.AlgoBits,
+			std::vector<uint8_t>{ 8, 8, 8 }, true, TableLayout::Linear, true);
+
+		coder.Encode = [streamCoder](Color* dest, const uint16_t* source, uint32_t nElements) {
+			streamCoder->Encode(dest, source, nElements);
+		};
+		coder.Decode = [streamCoder](uint16_t* dest, const Color* source, uint32_t nElements) {
+			streamCoder->Decode(dest, source, nElements);
+		};
+		coder.DecodeToDepth = [streamCoder](float* dest, const Color* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask) {
+			streamCoder->DecodeToDepth(dest, source, nElements, range, mask);
+		};
+	}
+
+	TiledCoder::TiledCoder(const TileGrid& grid, uint32_t frameWidth)
+		: tileSize(grid.TileSize), tilesX((frameWidth + grid.TileSize - 1) / grid.TileSize), frameWidth(frameWidth)
+	{
+		for (const TileHeader& header : grid.Tiles)
+		{
+			uint32_t index = 0;
+			while (index < coders.size() && !(coders[index].Header.Coder == header.Coder && coders[index].Header.AlgoBits == header.AlgoBits &&
+				coders[index].Header.Enlarge == header.Enlarge && coders[index].Header.Interpolate == header.Interpolate))
+				index++;
+
+			if (index == coders.size())
+			{
+				coders.emplace_back();
+				coders.back().Header = header;
+				switch (header.Coder)
+				{
+				case CoderType::Packed2: MakeCoder<Packed2>(coders.back()); break;
+				case CoderType::Packed3: MakeCoder<Packed3>(coders.back()); break;
+				case CoderType::Split2: MakeCoder<Split2>(coders.back()); break;
+				case CoderType::Split3: MakeCoder<Split3>(coders.back()); break;
+				case CoderType::Hilbert: MakeCoder<Hilbert>(coders.back()); break;
+				case CoderType::Morton: MakeCoder<Morton>(coders.back()); break;
+				case CoderType::Hue: MakeCoder<Hue>(coders.back()); break;
+				case CoderType::Triangle: MakeCoder<Triangle>(coders.back()); break;
+				default: MakeCoder<Phase>(coders.back()); break;
+				}
+			}
+			tileCoders.push_back(index);
+		}
+	}
+
+	void TiledCoder::encode(Color* dest, const uint16_t* source, uint32_t firstRow, uint32_t nRows)
+	{
+		for (uint32_t y = 0; y < nRows; y++)
+		{
+			for (uint32_t x = 0; x < frameWidth; x += tileSize)
+			{
+				uint32_t offset = y * frameWidth + x;
+				getCoder(x, firstRow + y).Encode(dest + offset, source + offset, std::min(tileSize, frameWidth - x));
+			}
+		}
+	}
+
+	void TiledCoder::decode(uint16_t* dest, const Color* source, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+		uint32_t scale /* = 1*/)
+	{
+		for (uint32_t row = 0; row < height; row++)
+		{
+			// Window columns [column, end) fall in the same tile
+			for (uint32_t column = 0; column < width;)
+			{
+				uint32_t frameX = x + column * scale;
+				uint32_t tileEnd = (frameX / tileSize + 1) * tileSize;
+				uint32_t end = std::min(width, (tileEnd - x + scale - 1) / scale);
+
+				uint32_t offset = row * width + column;
+				getCoder(frameX, y + row * scale).Decode(dest + offset, source + offset, end - column);
+				column = end;
+			}
+		}
+	}
+
+	void TiledCoder::decodeToDepth(float* dest, const Color* source, uint32_t firstRow, uint32_t nRows, const TileRanges& ranges,
+		const uint8_t* mask /* = nullptr*/)
+	{
+		uint32_t rangesX = (frameWidth + ranges.TileSize - 1) / ranges.TileSize;
+		for (uint32_t y = 0; y < nRows; y++)
+		{
+			const DepthRange* rowRanges = ranges.Ranges.data() + ((firstRow + y) / ranges.TileSize) * rangesX;
+			// Spans end at the next boundary of either grid
+			for (uint32_t x = 0; x < frameWidth;)
+			{
+				uint32_t end = std::min({ frameWidth, (x / tileSize + 1) * tileSize, (x / ranges.TileSize + 1) * ranges.TileSize });
+				uint32_t offset = y * frameWidth + x;
+				getCoder(x, firstRow + y).DecodeToDepth(dest + offset, source + offset, end - x, rowRanges[x / ranges.TileSize],
+					mask ? mask + offset : nullptr);
+				x = end;
+			}
+		}
+	}
+}
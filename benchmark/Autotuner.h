@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <DataStructs/Vec3.h>
+#include <TileHeader.h>
+#include <JpegEncoder.h>
+#include <JpegDecoder.h>
+
+namespace DStream
+{
+	struct AutotuneEvaluation
+	{
+		TileHeader Header;
+		size_t Size;
+		double BitsPerPixel;
+		double Rmse;
+		uint32_t MaxError;
+		double Cost;
+		double Ms;
+	};
+
+	// Picks the coder and algoBits of a tile. Every candidate encodes a subsampled copy of the tile, which goes
+	// through an in-memory JPEG at the configured quality and back, and the one with the lowest
+	// cost = rmse + lambda * bits per pixel wins. Candidates are tried in order until the time budget runs out,
+	// so the most promising ones should come first; the first candidate is always evaluated. Samples are capped to a
+	// number of pixels, so that a single evaluation, and the time a tune call can go past the budget, doesn't grow with
+	// the tile. Only the RGB JPEG path is scored: the choice is meant for tiles stored as RGB JPEGs.
+	class Autotuner
+	{
+	public:
+		Autotuner();
+
+		Autotuner(const Autotuner&) = delete;
+		void operator=(const Autotuner&) = delete;
+
+		void setCandidates(const std::vector<TileHeader>& candidates);
+		void setQuality(int quality);
+		// Depth units of RMSE worth one bit per pixel
+		void setLambda(double lambda);
+		// Milliseconds, 0 evaluates all the candidates
+		void setTimeBudget(double ms);
+		// Evaluation keeps every step-th pixel of every step-th row, with the smallest step that gives at most this many pixels
+		void setMaxSamplePixels(uint32_t pixels);
+
+		// stride is in elements, 0 for width. The returned header has the quality set
+		TileHeader tune(const uint16_t* depth, int width, int height, int stride = 0);
+
+		// Evaluations of the last tune call, in the order they were run
+		const std::vector<AutotuneEvaluation>& getEvaluations() const { return evaluations; }
+
+		// Coders and settings that are valid with 8 bits per channel, from the usually best to the usually worst
+		static std::vector<TileHeader> DefaultCandidates();
+
+	private:
+		template <typename T>
+		void evaluate(const TileHeader& header, AutotuneEvaluation& result);
+
+		std::vector<TileHeader> candidates;
+		int quality = 90;
+		double lambda = 64;
+		double timeBudget = 100;
+		uint32_t maxSamplePixels = 1 << 14;
+
+		JpegEncoder encoder;
+		JpegDecoder decoder;
+
+		int sampleWidth = 0, sampleHeight = 0;
+		std::vector<uint16_t> sample;
+		std::vector<uint16_t> decoded;
+		std::vector<uint8_t> colors;
+		std::vector<AutotuneEvaluation> evaluations;
+	};
+
+	// Codes frames tuned one tile at a time, with the coder in the header of every tile of the grid. A StreamCoder is built
+	// for every distinct header when the TiledCoder is created, with lazy tables so that only the colours that occur are
+	// tabulated; after that the TiledCoder can be used from several threads at once.
+	class TiledCoder
+	{
+	public:
+		// The grid must cover the frame, see TileGrid::Covers
+		TiledCoder(const TileGrid& grid, uint32_t frameWidth);
+
+		// Encodes rows [firstRow, firstRow + nRows) of the frame, dest and source point to the first of them
+		void encode(Color* dest, const uint16_t* source, uint32_t firstRow, uint32_t nRows);
+		// Decodes the width x height window at (x, y) of the frame, keeping every scale-th value of every scale-th row so that
+		// previews take the coder of the tile their block starts in. dest and source are tightly packed windows
+		void decode(uint16_t* dest, const Color* source, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t scale = 1);
+		// Decodes rows of a frame quantized in tiles straight to depth, see StreamCoder::DecodeToDepth. The range grid
+		// doesn't need to match the coder one
+		void decodeToDepth(float* dest, const Color* source, uint32_t firstRow, uint32_t nRows, const TileRanges& ranges,
+			const uint8_t* mask = nullptr);
+
+	private:
+		struct Coder
+		{
+			TileHeader Header;
+			std::function<void(Color*, const uint16_t*, uint32_t)> Encode;
+			std::function<void(uint16_t*, const Color*, uint32_t)> Decode;
+			std::function<void(float*, const Color*, uint32_t, const DepthRange&, const uint8_t*)> DecodeToDepth;
+		};
+
+		template <typename T>
+		static void MakeCoder(Coder& coder);
+
+		inline const Coder& getCoder(uint32_t x, uint32_t y) const { return coders[tileCoders[(y / tileSize) * tilesX + x / tileSize]]; }
+
+		uint32_t tileSize, tilesX, frameWidth;
+		std::vector<Coder> coders;
+		// Index in coders of the coder of every tile
+		std::vector<uint32_t> tileCoders;
+	};
+}
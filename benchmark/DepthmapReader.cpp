@@ -7,6 +7,7 @@
 #include <cstring>
 #include <fstream>
 #include <filesystem>
+#include <limits>
 
 namespace DStream
 {
@@ -71,25 +72,31 @@ namespace DStream
             return;
         }
 
-        float nodata;
+        float nodata = std::numeric_limits<float>::quiet_NaN();
         fscanf(fp, "ncols %d\n", &dmData.Width);
         fscanf(fp, "nrows %d\n", &dmData.Height);
         fscanf(fp, "xllcenter %f\n", &dmData.CenterX);
         fscanf(fp, "yllcenter %f\n", &dmData.CenterY);
         fscanf(fp, "cellsize %f\n", &dmData.CellSize);
         fscanf(fp, "nodata_value %f\n", &nodata);
+        dmData.NoDataValue = nodata;
 
         // Load depth data
         m_Data = new float[dmData.Width * dmData.Height];
-        float min = 1e20;
-        float max = -1e20;
 
         for (uint32_t i = 0; i < dmData.Width * dmData.Height; i++)
         {
             float h;
             fscanf(fp, "%f", &h);
-            dmData.MinDepth = std::min(min, h);
-            dmData.MaxDepth = std::max(max, h);
+            if (h == nodata)
+            {
+                m_Data[i] = std::numeric_limits<float>::quiet_NaN();
+                dmData.NoDataCount++;
+                continue;
+            }
+
+            dmData.MinDepth = std::min(dmData.MinDepth, h);
+            dmData.MaxDepth = std::max(dmData.MaxDepth, h);
             m_Data[i] = h;
         }
 
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <limits>
 
 // TODO: quantize in the generic function, parse in the specific ones
 
@@ -26,7 +27,11 @@ namespace DStream
         float CellSize = 0;
 
         float MinDepth = std::numeric_limits<float>().max();
-        float MaxDepth = std::numeric_limits<float>().min();
+        float MaxDepth = std::numeric_limits<float>().lowest();
+
+        // No-data values are stored as NaN in the raw data, see DepthMask
+        float NoDataValue = 0;
+        uint32_t NoDataCount = 0;
 
         DepthmapData() = default;
         DepthmapData(const DepthmapData& data) = default;
@@ -0,0 +1,248 @@
+#include "DsqCodec.h"
+
+#include <cstring>
+
+namespace DStream
+{
+	// OpChannel + c is followed by the residual of channel c alone: coders like Hilbert and Packed move along one
+	// axis of the RGB cube between neighbouring depths, often by more than the luma op can describe
+	enum : uint8_t { OpIndex = 0x00, OpDiff = 0x40, OpLuma = 0x80, OpRun = 0xC0, OpChannel = 0xFB, OpRgb = 0xFE };
+	static const uint8_t EndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	static const uint32_t MaxRun = 59;
+
+	static inline uint32_t Hash(const uint8_t* px)
+	{
+		return (px[0] * 3 + px[1] * 5 + px[2] * 7) & 63;
+	}
+
+	static inline uint8_t ClampedGradient(int left, int up, int upLeft)
+	{
+		int v = left + up - upLeft;
+		return v < 0 ? 0 : (v > 255 ? 255 : v);
+	}
+
+	// prev is the previously coded pixel, which is also the Left prediction across rows
+	template <DsqPredictor P>
+	static inline void Predict(const uint8_t* img, uint32_t x, uint32_t y, uint32_t rowSize, const uint8_t* prev, uint8_t* pred)
+	{
+		if (P == DsqPredictor::Left || y == 0)
+		{
+			memcpy(pred, prev, 3);
+			return;
+		}
+
+		const uint8_t* up = img + (size_t)y * rowSize - rowSize + x * 3;
+		if (x == 0)
+		{
+			memcpy(pred, up, 3);
+			return;
+		}
+
+		const uint8_t* upLeft = up - 3;
+		const uint8_t* left = up + rowSize - 3;
+		for (uint32_t c = 0; c < 3; c++)
+			pred[c] = ClampedGradient(left[c], up[c], upLeft[c]);
+	}
+
+	static inline void WriteUint32(uint8_t* dest, uint32_t v)
+	{
+		dest[0] = v >> 24; dest[1] = v >> 16; dest[2] = v >> 8; dest[3] = v;
+	}
+
+	static inline uint32_t ReadUint32(const uint8_t* src)
+	{
+		return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
+	}
+
+	template <DsqPredictor P>
+	static uint8_t* EncodePixels(const uint8_t* img, uint32_t width, uint32_t height, uint8_t* out)
+	{
+		uint8_t index[64 * 3] = { 0 };
+		uint8_t prev[3] = { 0, 0, 0 }, pred[3];
+		uint32_t rowSize = width * 3, run = 0;
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint8_t* px = img + (size_t)y * rowSize + x * 3;
+				Predict<P>(img, x, y, rowSize, prev, pred);
+				memcpy(prev, px, 3);
+
+				int8_t dr = px[0] - pred[0], dg = px[1] - pred[1], db = px[2] - pred[2];
+				if ((dr | dg | db) == 0)
+				{
+					if (++run == MaxRun)
+					{
+						*out++ = OpRun | (run - 1);
+						run = 0;
+					}
+					continue;
+				}
+
+				if (run > 0)
+				{
+					*out++ = OpRun | (run - 1);
+					run = 0;
+				}
+
+				uint32_t h = Hash(px);
+				if (memcmp(index + h * 3, px, 3) == 0)
+				{
+					*out++ = OpIndex | h;
+					continue;
+				}
+				memcpy(index + h * 3, px, 3);
+
+				int rg = dr - dg, bg = db - dg;
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+					*out++ = OpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+				else if (dg >= -32 && dg <= 31 && rg >= -8 && rg <= 7 && bg >= -8 && bg <= 7)
+				{
+					out[0] = OpLuma | (dg + 32);
+					out[1] = ((rg + 8) << 4) | (bg + 8);
+					out += 2;
+				}
+				else if ((dr != 0) + (dg != 0) + (db != 0) == 1)
+				{
+					uint32_t c = dr != 0 ? 0 : (dg != 0 ? 1 : 2);
+					out[0] = OpChannel + c;
+					out[1] = px[c] - pred[c];
+					out += 2;
+				}
+				else
+				{
+					out[0] = OpRgb;
+					out[1] = dr; out[2] = dg; out[3] = db;
+					out += 4;
+				}
+			}
+		}
+
+		if (run > 0)
+			*out++ = OpRun | (run - 1);
+		return out;
+	}
+
+	template <DsqPredictor P>
+	static bool DecodePixels(const uint8_t* data, const uint8_t* end, uint32_t width, uint32_t height, uint8_t* dest)
+	{
+		uint8_t index[64 * 3] = { 0 };
+		uint8_t prev[3] = { 0, 0, 0 }, pred[3];
+		uint32_t rowSize = width * 3, run = 0;
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint8_t* px = dest + (size_t)y * rowSize + x * 3;
+				Predict<P>(dest, x, y, rowSize, prev, pred);
+
+				if (run > 0)
+				{
+					run--;
+					memcpy(px, pred, 3);
+					memcpy(prev, px, 3);
+					continue;
+				}
+
+				if (data >= end)
+					return false;
+
+				uint8_t op = *data++;
+				if (op == OpRgb)
+				{
+					if (end - data < 3)
+						return false;
+					px[0] = pred[0] + data[0]; px[1] = pred[1] + data[1]; px[2] = pred[2] + data[2];
+					data += 3;
+				}
+				else if (op > OpRgb)
+					return false;
+				else if (op >= OpChannel)
+				{
+					if (data >= end)
+						return false;
+					memcpy(px, pred, 3);
+					px[op - OpChannel] += *data++;
+				}
+				else if ((op & 0xC0) == OpRun)
+				{
+					run = op & 0x3F;
+					memcpy(px, pred, 3);
+					memcpy(prev, px, 3);
+					continue;
+				}
+				else if ((op & 0xC0) == OpIndex)
+				{
+					memcpy(px, index + op * 3, 3);
+					memcpy(prev, px, 3);
+					continue;
+				}
+				else if ((op & 0xC0) == OpDiff)
+				{
+					px[0] = pred[0] + ((op >> 4) & 3) - 2;
+					px[1] = pred[1] + ((op >> 2) & 3) - 2;
+					px[2] = pred[2] + (op & 3) - 2;
+				}
+				else
+				{
+					if (data >= end)
+						return false;
+					int dg = (op & 0x3F) - 32;
+					px[0] = pred[0] + dg + (*data >> 4) - 8;
+					px[1] = pred[1] + dg;
+					px[2] = pred[2] + dg + (*data & 0xF) - 8;
+					data++;
+				}
+
+				memcpy(index + Hash(px) * 3, px, 3);
+				memcpy(prev, px, 3);
+			}
+		}
+
+		return true;
+	}
+
+	void DsqCodec::encode(const uint8_t* img, int width, int height, DsqPredictor predictor, std::vector<uint8_t>& out)
+	{
+		// Worst case is a raw residual for every pixel
+		out.resize(HeaderSize + (size_t)width * height * 4 + sizeof(EndMarker));
+		uint8_t* dest = out.data();
+
+		memcpy(dest, "dsqf", 4);
+		WriteUint32(dest + 4, width);
+		WriteUint32(dest + 8, height);
+		dest[12] = (uint8_t)predictor;
+		dest += HeaderSize;
+
+		if (predictor == DsqPredictor::Gradient)
+			dest = EncodePixels<DsqPredictor::Gradient>(img, width, height, dest);
+		else
+			dest = EncodePixels<DsqPredictor::Left>(img, width, height, dest);
+
+		memcpy(dest, EndMarker, sizeof(EndMarker));
+		out.resize(dest + sizeof(EndMarker) - out.data());
+	}
+
+	bool DsqCodec::readHeader(const uint8_t* data, size_t size, int& width, int& height)
+	{
+		if (size < HeaderSize + sizeof(EndMarker) || memcmp(data, "dsqf", 4) != 0 || data[12] > (uint8_t)DsqPredictor::Gradient)
+			return false;
+
+		width = ReadUint32(data + 4);
+		height = ReadUint32(data + 8);
+		return width > 0 && height > 0;
+	}
+
+	bool DsqCodec::decode(const uint8_t* data, size_t size, uint8_t* dest, int& width, int& height)
+	{
+		if (!readHeader(data, size, width, height))
+			return false;
+
+		const uint8_t* end = data + size - sizeof(EndMarker);
+		if ((DsqPredictor)data[12] == DsqPredictor::Gradient)
+			return DecodePixels<DsqPredictor::Gradient>(data + HeaderSize, end, width, height, dest);
+		return DecodePixels<DsqPredictor::Left>(data + HeaderSize, end, width, height, dest);
+	}
+}
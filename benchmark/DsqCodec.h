@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DStream
+{
+	// Left predicts every pixel with the previous one, like QOI, and is the fastest. Gradient uses the clamped
+	// left + up - upleft predictor of each channel, which can do better on surfaces sloping along both axes
+	enum class DsqPredictor { Left = 0, Gradient };
+
+	// Lossless QOI-style codec for 8 bit RGB frames. Every pixel is coded as its residual from the prediction with
+	// one of: a run of exact predictions, an index in a table of recently seen colours, a small per channel
+	// difference, a green-relative difference, a single channel difference or the raw residual. The stream is:
+	// "dsqf", width and height (big endian uint32), predictor byte, ops, 8 byte end marker
+	class DsqCodec
+	{
+	public:
+		static void encode(const uint8_t* img, int width, int height, DsqPredictor predictor, std::vector<uint8_t>& out);
+		// dest must hold width * height * 3 bytes
+		static bool decode(const uint8_t* data, size_t size, uint8_t* dest, int& width, int& height);
+		static bool readHeader(const uint8_t* data, size_t size, int& width, int& height);
+
+		static const uint32_t HeaderSize = 13;
+	};
+}
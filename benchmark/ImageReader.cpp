@@ -1,5 +1,8 @@
 #include <ImageReader.h>
 #include <JpegDecoder.h>
+#include <DsqCodec.h>
+#include <DepthCodec.h>
+#include <LumaLayout.h>
 
 #ifdef DSTREAM_ENABLE_PNG
 	#include <png.h>
@@ -15,8 +18,11 @@
 	#include <webp/decode.h>
 #endif
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
+#include <iterator>
+#include <vector>
 
 namespace DStream
 {
@@ -58,6 +64,28 @@ namespace DStream
 			stbi_info(path.c_str(), width, height, comp);
 #endif
 		}
+		else if (extension == ".dsq")
+		{
+			uint8_t header[DsqCodec::HeaderSize + 8];
+			std::ifstream file(path, std::ios::in | std::ios::binary);
+			file.read((char*)header, sizeof(header));
+
+			DsqCodec::readHeader(header, file.gcount(), *width, *height);
+			*comp = 3;
+		}
+		else if (extension == ".dsd")
+		{
+			uint8_t header[DepthCodec::HeaderSize + DepthCodec::ContextCount * DepthCodec::TokenCount * 2 + 4];
+			std::ifstream file(path, std::ios::in | std::ios::binary);
+			file.read((char*)header, sizeof(header));
+
+			uint32_t w = 0, h = 0;
+			uint16_t maxError;
+			DepthCodec::ReadHeader(header, file.gcount(), w, h, maxError);
+			*width = w;
+			*height = h;
+			*comp = 1;
+		}
 #ifdef DSTREAM_ENABLE_WEBP
 		else if (extension == ".webp")
 		{
@@ -99,6 +127,8 @@ namespace DStream
 			ReadJPEG(path, dest);
 		else if (extension == ".png")
 			ReadPNG(path, dest);
+		else if (extension == ".dsq")
+			ReadDSQ(path, dest);
 #ifdef DSTREAM_ENABLE_WEBP
 		else if (extension == ".webp")
 			ReadWEBP(path, dest, dataSize);
@@ -107,6 +137,55 @@ namespace DStream
 #endif
 	}
 
+	bool ImageReader::ReadRegion(const std::string& path, int x, int y, int width, int height, uint8_t* dest, size_t stride,
+		bool yuvPassthrough /* = false*/)
+	{
+		uint32_t extStart = path.find_last_of(".");
+		std::string extension = path.substr(extStart, path.length() - extStart);
+		for (uint32_t i = 0; i < extension.length(); i++)
+			extension[i] = tolower(extension[i]);
+
+		if (extension == ".jpg" || extension == ".jpeg")
+		{
+			std::ifstream file(path, std::ios::in | std::ios::binary);
+			std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+			JpegDecoder decoder;
+			if (yuvPassthrough)
+			{
+				// Same chroma as full decodes of luma layout files
+				decoder.setColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+				decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+				decoder.setFancyUpsampling(false);
+			}
+			else
+				decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+			return decoder.decodeRegion(data.data(), data.size(), x, y, width, height, dest, stride);
+		}
+
+		int imageWidth, imageHeight, comp;
+		GetImageSize(path, &imageWidth, &imageHeight, &comp, extension);
+		if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > imageWidth || y + height > imageHeight)
+			return false;
+
+		std::vector<uint8_t> image((size_t)imageWidth * imageHeight * 3);
+		if (extension == ".dsq")
+		{
+			if (!ReadDSQ(path, image.data()))
+				return false;
+		}
+#ifdef DSTREAM_ENABLE_WEBP
+		else if (extension == ".webp")
+			ReadWEBP(path, image.data(), image.size(), yuvPassthrough);
+#endif
+		else
+			Read(path, image.data(), image.size());
+
+		for (int i = 0; i < height; i++)
+			memcpy(dest + i * stride, image.data() + ((size_t)(y + i) * imageWidth + x) * 3, (size_t)width * 3);
+		return true;
+	}
+
 	void ImageReader::ReadJPEG(const std::string& path, uint8_t* dest)
 	{
 		// JPEG ENCODING / DECODING
@@ -115,6 +194,15 @@ namespace DStream
 		decoder.decodeNonAlloc(path.c_str(), dest, w, h);
 	}
 
+	void ImageReader::ReadJPEG420(const std::string& path, uint8_t* dest)
+	{
+		JpegDecoder decoder; int w, h;
+		decoder.setColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+		decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+		decoder.setFancyUpsampling(false);
+		decoder.decodeNonAlloc(path.c_str(), dest, w, h);
+	}
+
 	void ImageReader::ReadPNG(const std::string& path, uint8_t* dest)
 	{
 #ifdef DSTREAM_ENABLE_PNG
@@ -142,17 +230,71 @@ namespace DStream
 #endif
 	}
 
+	bool ImageReader::ReadDSQ(const std::string& path, uint8_t* dest)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		int w, h;
+		return DsqCodec::decode(fileData.data(), fileData.size(), dest, w, h);
+	}
+
+	bool ImageReader::ReadDSD(const std::string& path, uint16_t* dest)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		uint32_t w, h;
+		return DepthCodec::Decode(fileData.data(), fileData.size(), dest, w, h);
+	}
+
 #ifdef DSTREAM_ENABLE_WEBP
-	void ImageReader::ReadWEBP(const std::string& path, uint8_t* dest, int nElements)
+	bool ImageReader::DecodeWEBP(const uint8_t* data, size_t size, uint8_t* dest, int nElements, bool yuvPassthrough /* = false*/,
+		bool threaded /* = true*/)
+	{
+		WebPDecoderConfig config;
+		if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK)
+			return false;
+
+		config.options.use_threads = threaded;
+		if (yuvPassthrough)
+		{
+			uint32_t width = config.input.width, height = config.input.height;
+			if ((size_t)width * height * 3 > (size_t)nElements)
+				return false;
+
+			config.output.colorspace = MODE_YUV;
+			bool ok = WebPDecode(data, size, &config) == VP8_STATUS_OK;
+			if (ok)
+			{
+				const WebPYUVABuffer& yuv = config.output.u.YUVA;
+				LumaLayout::FromPlanar420((Color*)dest, width, height, yuv.y, yuv.u, yuv.v, yuv.y_stride, yuv.u_stride);
+			}
+			WebPFreeDecBuffer(&config.output);
+			return ok;
+		}
+
+		config.output.colorspace = MODE_RGB;
+		config.output.is_external_memory = 1;
+		config.output.u.RGBA.rgba = dest;
+		config.output.u.RGBA.stride = config.input.width * 3;
+		config.output.u.RGBA.size = nElements;
+
+		bool ok = WebPDecode(data, size, &config) == VP8_STATUS_OK;
+		WebPFreeDecBuffer(&config.output);
+		return ok;
+	}
+
+	void ImageReader::ReadWEBP(const std::string& path, uint8_t* dest, int nElements, bool yuvPassthrough /* = false*/,
+		bool threaded /* = true*/)
 	{
 		FILE* fp = fopen(path.c_str(), "rb");
 		uint8_t* fileData = new uint8_t[nElements];
 		size_t read = fread(fileData, sizeof(char), nElements, fp);
-		int w, h;
 
-		WebPGetInfo(fileData, read, &w, &h);
-		WebPDecodeRGBInto(fileData, read, dest, nElements, w * 3);
+		DecodeWEBP(fileData, read, dest, nElements, yuvPassthrough, threaded);
 
+		fclose(fp);
 		delete[] fileData;
 	}
 
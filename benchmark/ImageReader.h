@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace DStream
@@ -8,12 +10,27 @@ namespace DStream
 	{
 	public:
 		static void Read(const std::string& path, uint8_t* dest, uint32_t dataSize);
+		// Reads the width x height window at (x, y) into dest, whose rows are stride bytes apart. JPEGs only decode what
+		// covers the window (see JpegDecoder::decodeRegion), other formats are read whole and cropped. With yuvPassthrough
+		// JPEGs and WebPs written in luma priority layout are returned without colour conversion
+		static bool ReadRegion(const std::string& path, int x, int y, int width, int height, uint8_t* dest, size_t stride,
+			bool yuvPassthrough = false);
 
 		static void ReadJPEG(const std::string& path, uint8_t* dest);
+		// Reads files written with ImageWriter::WriteJPEG420, dest is in luma priority layout
+		static void ReadJPEG420(const std::string& path, uint8_t* dest);
 		static void ReadPNG(const std::string& path, uint8_t* dest);
+		// Returns false if the file is missing or corrupted
+		static bool ReadDSQ(const std::string& path, uint8_t* dest);
+		// Native 16 bit depth, dest receives the depth values instead of colours. Returns false if the file is missing or corrupted
+		static bool ReadDSD(const std::string& path, uint16_t* dest);
 
 #ifdef DSTREAM_ENABLE_WEBP
-		static void ReadWEBP(const std::string& path, uint8_t* dest, int nElements);
+		static void ReadWEBP(const std::string& path, uint8_t* dest, int nElements, bool yuvPassthrough = false, bool threaded = true);
+		// Decodes to RGB, nElements is the size of dest in bytes. With yuvPassthrough the YUV planes are returned as they are,
+		// in luma priority layout. threaded lets libwebp filter lossy images on a second thread
+		static bool DecodeWEBP(const uint8_t* data, size_t size, uint8_t* dest, int nElements, bool yuvPassthrough = false,
+			bool threaded = true);
 		static void ReadSplitWEBP(const std::string& path, uint8_t* dest, int nElements);
 #endif
 
@@ -1,6 +1,9 @@
 #include <ImageWriter.h>
 #include <DataStructs/Vec3.h>
 #include <JpegEncoder.h>
+#include <ParallelJpegEncoder.h>
+#include <DepthCodec.h>
+#include <LumaLayout.h>
 #ifdef DSTREAM_ENABLE_PNG
     #include <png.h>
 #else
@@ -16,6 +19,7 @@
 #endif
 
 #include <fstream>
+#include <vector>
 #include <iostream>
 #include <algorithm>
 
@@ -23,7 +27,8 @@
 
 namespace DStream
 {
-    void ImageWriter::WriteJPEG(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /* = 100*/)
+    void ImageWriter::WriteJPEG(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /* = 100*/,
+        const std::vector<std::array<unsigned int, 64>>& quantTables /* = {}*/)
     {
         uint8_t* encodedData = new uint8_t[width * height * 3];
         unsigned long retSize;
@@ -31,6 +36,7 @@ namespace DStream
 
         encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
         encoder.setQuality(quality);
+        encoder.setQuantTables(quantTables);
 
         encoder.init(width, height, &encodedData, &retSize);
         encoder.writeRows(data, height);
@@ -44,6 +50,73 @@ namespace DStream
         delete[] encodedData;
     }
 
+    void ImageWriter::WriteJPEG420(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /* = 100*/)
+    {
+        uint8_t* encodedData = new uint8_t[width * height * 3];
+        unsigned long retSize;
+        JpegEncoder encoder;
+
+        // Input and output colour spaces match, so libjpeg only downsamples the last two channels
+        encoder.setColorSpace(J_COLOR_SPACE::JCS_YCbCr, 3);
+        encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+        encoder.setChromaSubsampling(true);
+        encoder.setQuality(quality);
+
+        encoder.init(width, height, &encodedData, &retSize);
+        encoder.writeRows(data, height);
+        encoder.finish();
+
+        std::ofstream outFile;
+        outFile.open(path, std::ios::out | std::ios::binary);
+        outFile.write((const char*)encodedData, retSize);
+        outFile.close();
+
+        delete[] encodedData;
+    }
+
+    void ImageWriter::WriteJPEGParallel(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /* = 100*/,
+        uint32_t nThreads /* = 0*/, const std::vector<std::array<unsigned int, 64>>& quantTables /* = {}*/)
+    {
+        std::vector<uint8_t> encodedData;
+        ParallelJpegEncoder encoder(nThreads);
+
+        encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+        encoder.setQuality(quality);
+        encoder.setQuantTables(quantTables);
+        if (!encoder.encode(data, width, height, encodedData))
+        {
+            std::cerr << "Couldn't encode " << path << std::endl;
+            return;
+        }
+
+        std::ofstream outFile;
+        outFile.open(path, std::ios::out | std::ios::binary);
+        outFile.write((const char*)encodedData.data(), encodedData.size());
+        outFile.close();
+    }
+
+    void ImageWriter::WriteDSD(const std::string& path, uint16_t* data, uint32_t width, uint32_t height, uint16_t maxError /* = 0*/)
+    {
+        std::vector<uint8_t> encodedData;
+        DepthCodec::Encode(data, width, height, encodedData, maxError);
+
+        std::ofstream outFile;
+        outFile.open(path, std::ios::out | std::ios::binary);
+        outFile.write((const char*)encodedData.data(), encodedData.size());
+        outFile.close();
+    }
+
+    void ImageWriter::WriteDSQ(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, DsqPredictor predictor /* = DsqPredictor::Left*/)
+    {
+        std::vector<uint8_t> encodedData;
+        DsqCodec::encode(data, width, height, predictor, encodedData);
+
+        std::ofstream outFile;
+        outFile.open(path, std::ios::out | std::ios::binary);
+        outFile.write((const char*)encodedData.data(), encodedData.size());
+        outFile.close();
+    }
+
     void ImageWriter::WriteDecoded(const std::string& path, uint16_t* data, uint32_t width, uint32_t height)
     {
         Color* colorData = new Color[width * height];
@@ -94,64 +167,107 @@ namespace DStream
 #endif
     }
 
+#ifdef DSTREAM_ENABLE_ZIP
+    void ImageWriter::WritePNGParallel(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, const PngEncoder& encoder)
+    {
+        std::vector<uint8_t> encodedData;
+        if (!encoder.encode(data, width, height, 3, encodedData))
+        {
+            std::cerr << "Couldn't encode " << path << std::endl;
+            return;
+        }
+
+        std::ofstream outFile;
+        outFile.open(path, std::ios::out | std::ios::binary);
+        outFile.write((const char*)encodedData.data(), encodedData.size());
+        outFile.close();
+    }
+#endif
+
 #ifdef DSTREAM_ENABLE_WEBP
-    void ImageWriter::WriteWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /*= 0*/)
+    bool ImageWriter::EncodeWEBP(uint8_t* data, uint32_t width, uint32_t height, const WebpSettings& settings, std::vector<uint8_t>& out)
     {
-        /*
         WebPConfig config;
-        WebPConfigInit(&config);
+        if (!WebPConfigInit(&config))
+            return false;
 
-        int ret = WebPConfigPreset(&config, WebPPreset::WEBP_PRESET_DEFAULT, quality);
-        config.filter_strength = 0;
-        config.filter_type = 0;
-        config.method = 6;
-        config.exact = true;
-        config.filter_sharpness = 0;
-        config.near_lossless = 100;
-        config.sns_strength = 0;
-        config.use_sharp_yuv = true;
-        config.pass = 10;
-        config.segments = 4;
-        int config_error = WebPValidateConfig(&config);
+        if (settings.Lossless)
+        {
+            WebPConfigLosslessPreset(&config, settings.LosslessLevel);
+            config.near_lossless = settings.NearLossless;
+        }
+        else
+        {
+            config.quality = settings.Quality;
+            config.method = settings.Method;
+            config.sns_strength = settings.SnsStrength;
+            config.filter_strength = settings.FilterStrength;
+            config.filter_sharpness = settings.FilterSharpness;
+            config.filter_type = settings.FilterType;
+            config.segments = settings.Segments;
+            config.pass = settings.Pass;
+            config.use_sharp_yuv = settings.SharpYuv;
+        }
+        config.thread_level = settings.Threaded;
+        config.exact = settings.Exact;
+
+        if (!WebPValidateConfig(&config))
+            return false;
 
         WebPPicture pic;
-        WebPPictureInit(&pic);
+        if (!WebPPictureInit(&pic))
+            return false;
         pic.width = width;
         pic.height = height;
-        WebPPictureAlloc(&pic);
+        // Lossless works on ARGB, importing directly avoids a YUV round trip
+        pic.use_argb = settings.Lossless;
 
         WebPMemoryWriter writer;
         WebPMemoryWriterInit(&writer);
         pic.writer = WebPMemoryWrite;
         pic.custom_ptr = &writer;
-        pic.use_argb = false;
-
-        WebPPictureImportRGB(&pic, data, width * 3);
-        WebPEncode(&config, &pic);
-
-        // Write green, write red
-
-        std::ofstream outFile;
-        outFile.open(path, std::ios::out | std::ios::binary);
-        outFile.write((const char*)writer.mem, writer.size);
-        outFile.close();
 
-        WebPPictureFree(&pic);*/
+        bool ok;
+        if (settings.YuvPassthrough && !settings.Lossless)
+        {
+            pic.colorspace = WEBP_YUV420;
+            ok = WebPPictureAlloc(&pic);
+            if (ok)
+            {
+                LumaLayout::ToPlanar420((const Color*)data, width, height, pic.y, pic.u, pic.v, pic.y_stride, pic.uv_stride);
+                ok = WebPEncode(&config, &pic);
+            }
+        }
+        else
+            ok = WebPPictureImportRGB(&pic, data, width * 3) && WebPEncode(&config, &pic);
+        if (ok)
+            out.assign(writer.mem, writer.mem + writer.size);
 
-        uint8_t* buf;
-        size_t wrote;
+        WebPPictureFree(&pic);
+        WebPMemoryWriterClear(&writer);
+        return ok;
+    }
 
-        if (quality == 0)
-            wrote = WebPEncodeLosslessRGB(data, width, height, width * 3, &buf);
-        else
-            wrote = WebPEncodeRGB(data, width, height, width * 3, quality, &buf);
+    void ImageWriter::WriteWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, const WebpSettings& settings)
+    {
+        std::vector<uint8_t> encodedData;
+        if (!EncodeWEBP(data, width, height, settings, encodedData))
+        {
+            std::cerr << "Couldn't encode " << path << std::endl;
+            return;
+        }
 
         std::ofstream outFile;
         outFile.open(path, std::ios::out | std::ios::binary);
-        outFile.write((const char*)buf, wrote);
+        outFile.write((const char*)encodedData.data(), encodedData.size());
         outFile.close();
     }
 
+    void ImageWriter::WriteWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /*= 0*/)
+    {
+        WriteWEBP(path, data, width, height, quality == 0 ? WebpSettings::Balanced() : WebpSettings::LibwebpDefault(quality));
+    }
+
 
     void ImageWriter::WriteSplitWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality /*= 0*/)
     {
@@ -207,6 +323,7 @@ namespace DStream
         outFile.write((const char*)redWriter.mem, redWriter.size);
         outFile.close();
         WebPPictureFree(&redPic);
+        WebPMemoryWriterClear(&redWriter);
 
         // Encode and write green
         WebPPictureImportRGB(&greenPic, greenData, width * 3);
@@ -217,6 +334,7 @@ namespace DStream
         greenFile.write((const char*)greenWriter.mem, greenWriter.size);
         greenFile.close();
         WebPPictureFree(&greenPic);
+        WebPMemoryWriterClear(&greenWriter);
 
         delete[] redData;
         delete[] greenData;
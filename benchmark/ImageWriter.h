@@ -1,20 +1,124 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <string>
+#include <vector>
+
+#include <DsqCodec.h>
+#ifdef DSTREAM_ENABLE_ZIP
+#include <PngEncoder.h>
+#endif
 
 namespace DStream
 {
+#ifdef DSTREAM_ENABLE_WEBP
+	// Subset of WebPConfig that matters for encoded depth. LosslessLevel (0..9) maps to WebPConfigLosslessPreset
+	// and overrides Method and Quality when Lossless is set. Spatial noise shaping and the loop filter are off by
+	// default since they smooth the colours that carry the depth, and sharp RGB -> YUV conversion is on. These differ
+	// from the libwebp defaults, see LibwebpDefault
+	struct WebpSettings
+	{
+		bool Lossless = true;
+		int LosslessLevel = 6;
+		float Quality = 75;
+		int Method = 4;
+		bool Threaded = true;
+		bool Exact = true;
+		int NearLossless = 100;
+		bool SharpYuv = true;
+		int SnsStrength = 0;
+		int FilterStrength = 0;
+		int FilterSharpness = 0;
+		int FilterType = 0;
+		int Segments = 4;
+		int Pass = 1;
+		// Lossy only: the data is in luma priority layout (see LumaLayout) and is stored directly as YUV 4:2:0,
+		// skipping the RGB -> YUV conversion
+		bool YuvPassthrough = false;
+
+		static WebpSettings Fastest()
+		{
+			WebpSettings ret;
+			ret.LosslessLevel = 0;
+			return ret;
+		}
+
+		static WebpSettings Balanced() { return WebpSettings(); }
+
+		static WebpSettings Smallest()
+		{
+			WebpSettings ret;
+			ret.LosslessLevel = 9;
+			return ret;
+		}
+
+		static WebpSettings NearLosslessPreset(int nearLossless)
+		{
+			WebpSettings ret;
+			ret.NearLossless = nearLossless;
+			return ret;
+		}
+
+		static WebpSettings Lossy(float quality, int method = 4)
+		{
+			WebpSettings ret;
+			ret.Lossless = false;
+			ret.Quality = quality;
+			ret.Method = method;
+			return ret;
+		}
+
+		// Lossy with the settings of WebPConfigInit, the ones WebPEncodeRGB uses: spatial noise shaping, the loop filter
+		// and plain RGB -> YUV conversion. Files are smaller than with Lossy at the same quality, depth errors are larger
+		static WebpSettings LibwebpDefault(float quality)
+		{
+			WebpSettings ret = Lossy(quality);
+			ret.Exact = false;
+			ret.SharpYuv = false;
+			ret.SnsStrength = 50;
+			ret.FilterStrength = 60;
+			ret.FilterType = 1;
+			return ret;
+		}
+
+		static WebpSettings LumaPriority(float quality, int method = 4)
+		{
+			WebpSettings ret = Lossy(quality, method);
+			ret.YuvPassthrough = true;
+			return ret;
+		}
+	};
+#endif
+
 	class ImageWriter
 	{
 	public:
 		static void WriteDecoded(const std::string& path, uint16_t* data, uint32_t width, uint32_t height);
 
-		static void WriteJPEG(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 100);
+		// quantTables replace the standard tables, see JpegEncoder::setQuantTables
+		static void WriteJPEG(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 100,
+			const std::vector<std::array<unsigned int, 64>>& quantTables = {});
+		// Stores data in luma priority layout (see LumaLayout) as YCbCr 4:2:0 without colour conversion
+		static void WriteJPEG420(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 100);
+		// Encodes horizontal strips on nThreads threads (0: one per core), the file is a standard JPEG with restart markers
+		static void WriteJPEGParallel(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 100,
+			uint32_t nThreads = 0, const std::vector<std::array<unsigned int, 64>>& quantTables = {});
 		static void WritePNG(const std::string& path, uint8_t* data, uint32_t width, uint32_t height);
+		// Native 16 bit depth, lossless or with every value within maxError of the original
+		static void WriteDSD(const std::string& path, uint16_t* data, uint32_t width, uint32_t height, uint16_t maxError = 0);
+		static void WriteDSQ(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, DsqPredictor predictor = DsqPredictor::Left);
+#ifdef DSTREAM_ENABLE_ZIP
+		// Filters and compresses on multiple threads with the settings of the encoder
+		static void WritePNGParallel(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, const PngEncoder& encoder);
+#endif
 
 #ifdef DSTREAM_ENABLE_WEBP
+		// Quality 0 is lossless (WebpSettings::Balanced), any other is lossy with the libwebp defaults (WebpSettings::LibwebpDefault)
 		static void WriteWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 0);
+		static void WriteWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, const WebpSettings& settings);
+		// Encodes in memory, returns false if the settings are invalid or the encoder fails
+		static bool EncodeWEBP(uint8_t* data, uint32_t width, uint32_t height, const WebpSettings& settings, std::vector<uint8_t>& out);
 		static void WriteSplitWEBP(const std::string& path, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality = 0);
 #endif
 	};
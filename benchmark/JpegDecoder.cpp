@@ -1,5 +1,8 @@
 #include "JpegDecoder.h"
 
+#include <cstring>
+#include <vector>
+
 namespace DStream
 {
 	JpegDecoder::JpegDecoder() {
@@ -25,6 +28,14 @@ namespace DStream
 		return colorSpace;
 	}
 
+	void JpegDecoder::setScale(int denominator) {
+		scale = denominator;
+	}
+
+	void JpegDecoder::setFancyUpsampling(bool fancy) {
+		fancyUpsampling = fancy;
+	}
+
 	bool JpegDecoder::decode(uint8_t* buffer, size_t len, uint8_t*& img, int& width, int& height) {
 		if (buffer == nullptr)
 			return false;
@@ -61,11 +72,61 @@ namespace DStream
 		return true;
 	}
 
+	bool JpegDecoder::decodeNonAlloc(const uint8_t* data, size_t len, uint8_t* buffer, int& width, int& height)
+	{
+		if (data == nullptr)
+			return false;
+		jpeg_mem_src(&decInfo, (unsigned char*)data, len);
+		init(width, height);
+		int readed = readRows(height, buffer);
+		if (readed != height)
+			return false;
+		return true;
+	}
+
+
+	bool JpegDecoder::decodeRegion(const uint8_t* data, size_t len, int x, int y, int width, int height, uint8_t* buffer, size_t stride)
+	{
+		if (data == nullptr)
+			return false;
+		jpeg_mem_src(&decInfo, (unsigned char*)data, len);
+
+		int imageWidth, imageHeight;
+		init(imageWidth, imageHeight);
+		if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > imageWidth || y + height > imageHeight) {
+			jpeg_abort_decompress(&decInfo);
+			return false;
+		}
+
+		// Column of the image at the start of each decoded row. The crop starts on an iMCU boundary, firstColumn is
+		// moved back to it; without cropping rows start at column 0
+		JDIMENSION firstColumn = 0;
+#ifdef LIBJPEG_TURBO_VERSION
+		firstColumn = x;
+		JDIMENSION cropWidth = width;
+		jpeg_crop_scanline(&decInfo, &firstColumn, &cropWidth);
+		jpeg_skip_scanlines(&decInfo, y);
+#endif
+
+		std::vector<uint8_t> row(rowSize());
+		JSAMPROW rows[1] = { row.data() };
+		while ((int)decInfo.output_scanline < y)
+			jpeg_read_scanlines(&decInfo, rows, 1);
+
+		size_t components = decInfo.output_components;
+		for (int i = 0; i < height; i++) {
+			jpeg_read_scanlines(&decInfo, rows, 1);
+			memcpy(buffer + i * stride, row.data() + (x - firstColumn) * components, width * components);
+		}
+
+		jpeg_abort_decompress(&decInfo);
+		return true;
+	}
 
 	bool JpegDecoder::decode(uint8_t*& img, int& width, int& height) {
 		init(width, height);
 
-		img = new uint8_t[decInfo.image_height * rowSize()];
+		img = new uint8_t[decInfo.output_height * rowSize()];
 
 		int readed = readRows(height, img);
 		if (readed != height)
@@ -94,33 +155,36 @@ namespace DStream
 		decInfo.out_color_space = colorSpace;
 		decInfo.jpeg_color_space = jpegColorSpace;
 		decInfo.raw_data_out = (boolean)false;
+		decInfo.scale_num = 1;
+		decInfo.scale_denom = scale;
+		decInfo.do_fancy_upsampling = (boolean)fancyUpsampling;
 
 		if (decInfo.num_components > 1)
 			subsampled = decInfo.comp_info[1].h_samp_factor != 1;
 
 		jpeg_start_decompress(&decInfo);
 
-		width = decInfo.image_width;
-		height = decInfo.image_height;
+		width = decInfo.output_width;
+		height = decInfo.output_height;
 		return true;
 	}
 
 	size_t JpegDecoder::readRows(int nrows, uint8_t* buffer) { //return false on end.
-		if (decInfo.output_scanline == decInfo.image_height)
+		if (decInfo.output_scanline == decInfo.output_height)
 			restart();
 
-		size_t rowSize = decInfo.image_width * decInfo.num_components;
+		size_t rowSize = this->rowSize();
 		JSAMPROW rows[1];
 		size_t offset = 0;
 		int readed = 0;
-		while (decInfo.output_scanline < decInfo.image_height && readed < nrows) {
+		while (decInfo.output_scanline < decInfo.output_height && readed < nrows) {
 			readed++;
 			rows[0] = buffer + offset;
 			jpeg_read_scanlines(&decInfo, rows, 1);
 			offset += rowSize;
 		}
 
-		if (decInfo.output_scanline == decInfo.image_height)
+		if (decInfo.output_scanline == decInfo.output_height)
 			jpeg_finish_decompress(&decInfo);
 		return readed;
 	}
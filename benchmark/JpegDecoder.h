@@ -22,15 +22,28 @@ namespace DStream
 		void setColorSpace(J_COLOR_SPACE space);
 		void setJpegColorSpace(J_COLOR_SPACE colorSpace);
 		J_COLOR_SPACE getColorSpace() const;
+		// Decodes at 1/denominator of the size (1, 2, 4 or 8) by scaling the DCT, width and height are rounded up.
+		// Every pixel is the average of a block of the full size image
+		void setScale(int denominator);
+		int getScale() const { return scale; }
+		// Interpolates subsampled chroma, the libjpeg default. Replicating it instead (false) matches LumaLayout::FromPlanar420,
+		// and makes the chroma of region decodes the same as in full decodes
+		void setFancyUpsampling(bool fancy);
 		bool decode(uint8_t* buffer, size_t len, uint8_t*& img, int& width, int& height);
 		bool decode(const char* path, uint8_t*& img, int& width, int& height);
 		bool decodeNonAlloc(const char* path, uint8_t* buffer, int& width, int& height);
+		bool decodeNonAlloc(const uint8_t* data, size_t len, uint8_t* buffer, int& width, int& height);
 		bool decode(FILE* file, uint8_t*& img, int& width, int& height);
+		// Decodes the width x height window at (x, y) into buffer, whose rows are stride bytes apart. With libjpeg-turbo
+		// only the iMCU columns covering the window are decoded and the rows above it are skipped, other libraries
+		// decode the rows above it without storing them. Fails if the window is not inside the image. Subsampled chroma
+		// only matches the one of a full decode without fancy upsampling
+		bool decodeRegion(const uint8_t* data, size_t len, int x, int y, int width, int height, uint8_t* buffer, size_t stride);
 
 		//file streaming reading support
 		bool init(const char* path, int& width, int& height);
 
-		size_t rowSize() { return decInfo.image_width * decInfo.num_components; }
+		size_t rowSize() { return decInfo.output_width * decInfo.output_components; }
 
 		//buffer must have rows*rowSize() space at least!
 		size_t readRows(int rows, uint8_t* buffer); //return false on end.
@@ -50,5 +63,7 @@ namespace DStream
 		J_COLOR_SPACE jpegColorSpace = JCS_YCbCr;
 
 		bool subsampled = false;
+		int scale = 1;
+		bool fancyUpsampling = true;
 	};
 }
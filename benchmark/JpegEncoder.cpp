@@ -46,6 +46,22 @@ namespace DStream
 		this->subsample = subsample;
 	}
 
+	void JpegEncoder::setRestartRows(int rows) {
+		this->restartRows = rows;
+	}
+
+	void JpegEncoder::setQuantTables(const std::vector<std::array<unsigned int, 64>>& tables) {
+		this->quantTables = tables;
+	}
+
+	void JpegEncoder::applyQuantTables() {
+		int scale = jpeg_quality_scaling(quality);
+		for (int i = 0; i < (int)quantTables.size() && i < info.num_components && i < NUM_QUANT_TBLS; i++) {
+			jpeg_add_quant_table(&info, i, quantTables[i].data(), scale, (boolean)true);
+			info.comp_info[i].quant_tbl_no = i;
+		}
+	}
+
 
 
 	bool JpegEncoder::encode(uint8_t* img, int width, int height, FILE* file) {
@@ -84,7 +100,9 @@ namespace DStream
 		jpeg_set_defaults(&info);
 		jpeg_set_colorspace(&info, jpegColorSpace);
 		jpeg_set_quality(&info, quality, (boolean)true);
+		applyQuantTables();
 		info.optimize_coding = (boolean)optimize;
+		info.restart_in_rows = restartRows;
 
 		if (jpegColorSpace == JCS_YCbCr && subsample == false) {
 			for (int i = 0; i < numComponents; i++) {
@@ -127,7 +145,9 @@ namespace DStream
 		jpeg_set_defaults(&info);
 		jpeg_set_colorspace(&info, jpegColorSpace);
 		jpeg_set_quality(&info, quality, (boolean)true);
+		applyQuantTables();
 		info.optimize_coding = (boolean)optimize;
+		info.restart_in_rows = restartRows;
 
 		if (jpegColorSpace == JCS_YCbCr && subsample == false)
 			for (int i = 0; i < numComponents; i++) {
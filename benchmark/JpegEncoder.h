@@ -3,6 +3,8 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstdint>
+#include <array>
+#include <vector>
 
 #include <jpeglib.h>
 
@@ -26,6 +28,11 @@ namespace DStream
 		int getQuality() const;
 		void setOptimize(bool optimize);
 		void setChromaSubsampling(bool subsample);
+		// Emits a restart marker every n MCU rows, 0 disables them
+		void setRestartRows(int rows);
+		// Component i is quantized with tables[i] (natural order) instead of the standard tables. They're scaled by
+		// the quality like the standard ones, quality 50 uses them as they are. An empty vector restores the defaults
+		void setQuantTables(const std::vector<std::array<unsigned int, 64>>& tables);
 
 		bool encode(uint8_t* img, int width, int height, FILE* file);
 		bool encode(uint8_t* img, int width, int height, const char* path);
@@ -38,6 +45,7 @@ namespace DStream
 	private:
 		bool init(int width, int height);
 		bool encode(uint8_t* img, int width, int height);
+		void applyQuantTables();
 		static void onError(j_common_ptr cinfo);
 		static void onMessage(j_common_ptr cinfo);
 
@@ -50,6 +58,8 @@ namespace DStream
 		int numComponents = 3;
 		bool optimize = true;
 		bool subsample = false;
+		int restartRows = 0;
+		std::vector<std::array<unsigned int, 64>> quantTables;
 
 		int quality = 90;
 	};
@@ -4,7 +4,18 @@
 #include <ImageWriter.h>
 #include <ImageReader.h>
 #include <JpegDecoder.h>
+#include <JpegEncoder.h>
+#include <ParallelJpegEncoder.h>
+#include <DsqCodec.h>
+#include <DepthCodec.h>
+#include <LumaLayout.h>
+#include <RateControl.h>
+#include <Autotuner.h>
+#include <TileHeader.h>
+#include <DepthMask.h>
+#include <QuantTables.h>
 #include <Timer.h>
+#include <PerfCounter.h>
 
 #include <Implementations/Hilbert.h>
 #include <Implementations/Phase.h>
@@ -21,6 +32,9 @@
 #include <filesystem>
 #include <map>
 #include <unordered_set>
+#include <chrono>
+#include <array>
+#include <thread>
 
 using namespace DStream;
 
@@ -31,6 +45,7 @@ enum class ImageFormat
 {
 	JPG = 0
 	, PNG
+	, DSQ
 #ifdef DSTREAM_ENABLE_WEBP
 	, WEBP, SPLIT_WEBP
 #endif
@@ -69,6 +84,69 @@ struct BenchmarkConfig
 	std::string CurrentPath;
 };
 
+// Absolute errors of values against reference, only where valid is non-zero if given
+struct ErrorStats
+{
+	double Avg = 0;
+	double Rmse = 0;
+	double Max = 0;
+	uint32_t Count = 0;
+};
+
+template <typename V, typename R>
+ErrorStats GetErrorStats(const V* values, const R* reference, uint32_t nElements, const uint8_t* valid = nullptr)
+{
+	ErrorStats stats;
+	double sum = 0, squaredSum = 0;
+	for (uint32_t i = 0; i < nElements; i++)
+	{
+		if (valid && !valid[i])
+			continue;
+		double error = std::abs((double)values[i] - (double)reference[i]);
+		sum += error;
+		squaredSum += error * error;
+		stats.Max = std::max(stats.Max, error);
+		stats.Count++;
+	}
+
+	if (stats.Count)
+	{
+		stats.Avg = sum / stats.Count;
+		stats.Rmse = std::sqrt(squaredSum / stats.Count);
+	}
+	return stats;
+}
+
+// Encodes the coded colours to an RGB JPEG and decodes it to the colour buffer, returns the size of the JPEG
+int RoundTripJpeg(BenchmarkConfig& config, int quality = 90, const std::vector<std::array<unsigned int, 64>>& quantTables = {})
+{
+	JpegEncoder encoder;
+	JpegDecoder decoder;
+	encoder.setJpegColorSpace(JCS_RGB);
+	decoder.setJpegColorSpace(JCS_RGB);
+	encoder.setQuality(quality);
+	encoder.setQuantTables(quantTables);
+
+	uint8_t* jpeg = nullptr;
+	int length = 0, w, h;
+	encoder.encode(config.EncodedBuffer, config.Width, config.Height, jpeg, length);
+	decoder.decodeNonAlloc(jpeg, length, config.ColorBuffer, w, h);
+	free(jpeg);
+
+	return length;
+}
+
+// Runs a benchmark with another coder, the ones after it get Hilbert with 5 bits again
+template <typename Benchmark>
+void Run(BenchmarkConfig& config, const std::string& coderName, uint8_t algoBits, Benchmark benchmark)
+{
+	config.CoderName = coderName;
+	config.AlgoBits = algoBits;
+	benchmark(config);
+	config.CoderName = "Hilbert";
+	config.AlgoBits = 5;
+}
+
 std::vector<uint8_t> GetAlgoBitsToTest(const std::string& algo)
 {
 	std::vector<uint8_t> ret;
@@ -302,6 +380,7 @@ void BenchmarkCoder(BenchmarkConfig& config)
 			{
 			case ImageFormat::JPG: ImageWriter::WriteJPEG(currPath + ss.str() + ".jpg", config.EncodedBuffer, width, height, jpegLevels[j]); break;
 			case ImageFormat::PNG: ImageWriter::WritePNG(currPath + ss.str() + ".png", config.EncodedBuffer, width, height); break;
+			case ImageFormat::DSQ: ImageWriter::WriteDSQ(currPath + ss.str() + ".dsq", config.EncodedBuffer, width, height); break;
 #ifdef DSTREAM_ENABLE_WEBP
 			case ImageFormat::WEBP: ImageWriter::WriteWEBP(currPath + ss.str() + ".webp", config.EncodedBuffer, width, height, jpegLevels[j]); break;
 			case ImageFormat::SPLIT_WEBP: ImageWriter::WriteSplitWEBP(currPath + ss.str(), config.EncodedBuffer, width, height, jpegLevels[j]); break;
@@ -316,6 +395,10 @@ void BenchmarkCoder(BenchmarkConfig& config)
 			{
 			case ImageFormat::JPG: ImageReader::ReadJPEG(currPath + ss.str() + ".jpg", config.ColorBuffer); break;
 			case ImageFormat::PNG: ImageReader::ReadPNG(currPath + ss.str() + ".png", config.ColorBuffer); break;
+			case ImageFormat::DSQ:
+				if (!ImageReader::ReadDSQ(currPath + ss.str() + ".dsq", config.ColorBuffer))
+					std::cerr << "Could not decode " << currPath + ss.str() + ".dsq" << std::endl;
+				break;
 #ifdef DSTREAM_ENABLE_WEBP
 			case ImageFormat::WEBP: ImageReader::ReadWEBP(currPath + ss.str() + ".webp", config.ColorBuffer, nElements * 3); break;
 			case ImageFormat::SPLIT_WEBP: ImageReader::ReadSplitWEBP(currPath + ss.str(), config.ColorBuffer, nElements * 3); break;
@@ -343,6 +426,7 @@ void BenchmarkCoder(BenchmarkConfig& config)
 		{
 		case ImageFormat::JPG: extension = ".jpg"; break;
 		case ImageFormat::PNG: extension = ".png"; break;
+		case ImageFormat::DSQ: extension = ".dsq"; break;
 #ifdef DSTREAM_ENABLE_WEBP
 		case ImageFormat::WEBP: extension = ".webp"; break;
 		case ImageFormat::SPLIT_WEBP: extension = ""; break;
@@ -368,6 +452,988 @@ void BenchmarkCoder(BenchmarkConfig& config)
 	csv.close();
 }
 
+// Direct 16 bit coding, as a reference for the colour coders. Max errors take the place of the JPEG quality in results.csv
+void BenchmarkDepthCodec(BenchmarkConfig& config)
+{
+	uint32_t width = config.Width, height = config.Height;
+	uint32_t nElements = width * height;
+	uint32_t nRuns = 3;
+	uint16_t maxErrors[4] = { 0, 1, 4, 16 };
+
+	std::ofstream csv(outputFolder + "/results.csv", std::ios::out | std::ios::app);
+	std::ofstream timeCsv(outputFolder + "/depthcodec.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+
+	for (uint32_t e = 0; e < 4; e++)
+	{
+		std::vector<uint8_t> encoded;
+		double encodeMs = 0, decodeMs = 0;
+		for (uint32_t r = 0; r < nRuns; r++)
+		{
+			uint32_t w, h;
+			auto start = std::chrono::high_resolution_clock::now();
+			DepthCodec::Encode(config.QuantizedData, width, height, encoded, maxErrors[e]);
+			auto mid = std::chrono::high_resolution_clock::now();
+			DepthCodec::Decode(encoded.data(), encoded.size(), config.DecodedData, w, h);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			encodeMs += std::chrono::duration<double, std::milli>(mid - start).count();
+			decodeMs += std::chrono::duration<double, std::milli>(end - mid).count();
+		}
+
+		std::stringstream ss;
+		ss << "MaxError" << maxErrors[e];
+		ErrorData err;
+		SaveError(config.QuantizedData, config.DecodedData, config.ColorBuffer, width, height, config.CurrentPath + ss.str() + "_decoded", err);
+		err.EncodedTextureSize = encoded.size();
+		AddBenchmarkResult(csv, "DepthCodec", maxErrors[e], 0, err);
+
+		timeCsv << maxErrors[e] << "," << encodeMs / nRuns << "," << decodeMs / nRuns << "," << encoded.size() << "\n";
+		std::cout << "DepthCodec max error " << maxErrors[e] << ": " << encodeMs / nRuns << "ms encode, " << decodeMs / nRuns << "ms decode, "
+			<< encoded.size() << " bytes" << std::endl;
+	}
+}
+
+template <typename T>
+void BenchmarkTableLayouts(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 5;
+	std::string jpegPath = outputFolder + "/LayoutInput.jpg";
+	std::ofstream csv(outputFolder + "/layouts.csv", std::ios::out | std::ios::app);
+
+	// Decode a real JPEG so that the colours contain compression noise
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+	ImageWriter::WriteJPEG(jpegPath, config.EncodedBuffer, config.Width, config.Height, 90);
+	ImageReader::ReadJPEG(jpegPath, config.ColorBuffer);
+
+	std::pair<TableLayout, std::string> layouts[3] = {
+		{ TableLayout::Linear, "Linear" }, { TableLayout::Blocked, "Blocked" }, { TableLayout::Morton, "Morton" }
+	};
+
+	for (uint32_t l = 0; l < 3; l++)
+	{
+		coder.SetTableLayout(layouts[l].first);
+
+		PerfCounter cacheMisses(PerfEvent::CacheMisses);
+		PerfCounter l1Misses(PerfEvent::L1DReadMisses);
+		PerfCounter tlbMisses(PerfEvent::DTLBReadMisses);
+		int64_t cache = 0, l1 = 0, tlb = 0;
+		double ms = 0;
+
+		// Each counter can be unavailable on its own (e.g. no dTLB events in some VMs), a failed read voids its total
+		auto addCount = [](int64_t& total, int64_t count) { total = total < 0 || count < 0 ? -1 : total + count; };
+		auto writeCount = [&](PerfCounter& counter, int64_t total) {
+			if (counter.Valid() && total >= 0)
+				csv << "," << total / nRuns;
+			else
+				csv << ",/";
+		};
+
+		for (uint32_t r = 0; r < nRuns; r++)
+		{
+			cacheMisses.Start(); l1Misses.Start(); tlbMisses.Start();
+			auto start = std::chrono::high_resolution_clock::now();
+			coder.Decode(config.DecodedData, (Color*)config.ColorBuffer, nElements);
+			auto end = std::chrono::high_resolution_clock::now();
+			addCount(cache, cacheMisses.Stop()); addCount(l1, l1Misses.Stop()); addCount(tlb, tlbMisses.Stop());
+
+			ms += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		csv << config.CoderName << "," << layouts[l].second << "," << ms / nRuns;
+		writeCount(cacheMisses, cache);
+		writeCount(l1Misses, l1);
+		writeCount(tlbMisses, tlb);
+		csv << "\n";
+		std::cout << config.CoderName << " " << layouts[l].second << ": " << ms / nRuns << "ms" << std::endl;
+	}
+
+	csv.close();
+}
+
+template <typename T>
+void BenchmarkTableGather(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 5;
+	std::string jpegPath = outputFolder + "/GatherInput.jpg";
+	std::ofstream csv(outputFolder + "/gather.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+	ImageWriter::WriteJPEG(jpegPath, config.EncodedBuffer, config.Width, config.Height, 90);
+	ImageReader::ReadJPEG(jpegPath, config.ColorBuffer);
+
+	const Color* colors = (Color*)config.ColorBuffer;
+	const uint16_t* table = coder.GetDecodingTable();
+	std::vector<uint16_t> scalar(nElements);
+	double scalarMs = 0, batchedMs = 0;
+
+	for (uint32_t r = 0; r < nRuns; r++)
+	{
+		// One dependent load per pixel
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < nElements; i++)
+			scalar[i] = table[TableIndex::Linear(colors[i].x, colors[i].y, colors[i].z)];
+		auto mid = std::chrono::high_resolution_clock::now();
+		coder.Decode(config.DecodedData, colors, nElements);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		scalarMs += std::chrono::duration<double, std::milli>(mid - start).count();
+		batchedMs += std::chrono::duration<double, std::milli>(end - mid).count();
+	}
+
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < nElements; i++)
+		mismatches += scalar[i] != config.DecodedData[i];
+	if (mismatches)
+		std::cout << config.CoderName << " table decode: " << mismatches << " values differ between the scalar and batched gathers" << std::endl;
+
+	csv << config.CoderName << "," << scalarMs / nRuns << "," << batchedMs / nRuns << "," << mismatches << "\n";
+	std::cout << config.CoderName << " table decode, scalar: " << scalarMs / nRuns << "ms, batched: " << batchedMs / nRuns << "ms" << std::endl;
+	csv.close();
+}
+
+template <typename T>
+void BenchmarkParallelJpeg(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 5;
+	std::ofstream csv(outputFolder + "/jpeg_parallel.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, false);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	// Serial baseline, the JpegEncoder used by WriteJPEG
+	uint8_t* serialJpeg = nullptr;
+	int serialLength = 0, w, h;
+	double serialMs = 0;
+	for (uint32_t r = 0; r < nRuns; r++)
+	{
+		free(serialJpeg);
+		serialJpeg = nullptr;
+
+		JpegEncoder encoder;
+		encoder.setJpegColorSpace(JCS_RGB);
+		encoder.setQuality(90);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		encoder.encode(config.EncodedBuffer, config.Width, config.Height, serialJpeg, serialLength);
+		auto end = std::chrono::high_resolution_clock::now();
+		serialMs += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	JpegDecoder decoder;
+	decoder.setJpegColorSpace(JCS_RGB);
+	std::vector<uint8_t> serialDecoded(nElements * 3);
+	decoder.decodeNonAlloc(serialJpeg, serialLength, serialDecoded.data(), w, h);
+	free(serialJpeg);
+
+	csv << config.CoderName << ",Serial,1," << serialMs / nRuns << "," << serialLength << ",0\n";
+	std::cout << config.CoderName << " JPEG encoding, serial: " << serialMs / nRuns << "ms, " << serialLength << " bytes" << std::endl;
+
+	uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+	{
+		ParallelJpegEncoder encoder(nThreads);
+		encoder.setJpegColorSpace(JCS_RGB);
+		encoder.setQuality(90);
+
+		std::vector<uint8_t> jpeg;
+		double ms = 0;
+		for (uint32_t r = 0; r < nRuns; r++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			encoder.encode(config.EncodedBuffer, config.Width, config.Height, jpeg);
+			auto end = std::chrono::high_resolution_clock::now();
+			ms += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		// Restart markers and Huffman tables don't change the coefficients, the stitched file must decode to the serial one
+		uint32_t mismatches = nElements * 3;
+		if (decoder.decodeNonAlloc(jpeg.data(), jpeg.size(), config.ColorBuffer, w, h) && (uint32_t)w == config.Width && (uint32_t)h == config.Height)
+		{
+			mismatches = 0;
+			for (uint32_t i = 0; i < nElements * 3; i++)
+				mismatches += config.ColorBuffer[i] != serialDecoded[i];
+		}
+		if (mismatches)
+			std::cout << config.CoderName << " JPEG encoding, " << nThreads << " threads: " << mismatches << " bytes differ from the serial decode" << std::endl;
+
+		csv << config.CoderName << ",Parallel," << nThreads << "," << ms / nRuns << "," << jpeg.size() << "," << mismatches << "\n";
+		std::cout << config.CoderName << " JPEG encoding, " << nThreads << " threads: " << ms / nRuns << "ms, " << jpeg.size() << " bytes" << std::endl;
+	}
+
+	csv.close();
+}
+
+#ifdef DSTREAM_ENABLE_ZIP
+template <typename T>
+void BenchmarkPng(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 3;
+	std::ofstream csv(outputFolder + "/png.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, false);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	// Current writer
+	std::string pngPath = outputFolder + "/PngBaseline.png";
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t r = 0; r < nRuns; r++)
+		ImageWriter::WritePNG(pngPath, config.EncodedBuffer, config.Width, config.Height);
+	auto end = std::chrono::high_resolution_clock::now();
+	double baselineMs = std::chrono::duration<double, std::milli>(end - start).count() / nRuns;
+	csv << config.CoderName << ",libpng,/,/,/," << baselineMs << "," << std::filesystem::file_size(pngPath) << "\n";
+
+	std::pair<PngFilter, std::string> filters[4] = {
+		{ PngFilter::None, "None" }, { PngFilter::Up, "Up" }, { PngFilter::Paeth, "Paeth" }, { PngFilter::Adaptive, "Adaptive" }
+	};
+	std::pair<int, std::string> strategies[2] = { { Z_DEFAULT_STRATEGY, "Default" }, { Z_RLE, "RLE" } };
+	int levels[3] = { 1, 6, 9 };
+
+	for (uint32_t f = 0; f < 4; f++)
+	{
+		for (uint32_t s = 0; s < 2; s++)
+		{
+			for (uint32_t l = 0; l < 3; l++)
+			{
+				PngEncoder encoder;
+				encoder.setFilter(filters[f].first);
+				encoder.setStrategy(strategies[s].first);
+				encoder.setCompressionLevel(levels[l]);
+
+				std::vector<uint8_t> png;
+				double ms = 0;
+				for (uint32_t r = 0; r < nRuns; r++)
+				{
+					start = std::chrono::high_resolution_clock::now();
+					encoder.encode(config.EncodedBuffer, config.Width, config.Height, 3, png);
+					end = std::chrono::high_resolution_clock::now();
+					ms += std::chrono::duration<double, std::milli>(end - start).count();
+				}
+
+				csv << config.CoderName << ",Parallel," << filters[f].second << "," << strategies[s].second << "," << levels[l] << ","
+					<< ms / nRuns << "," << png.size() << "\n";
+				std::cout << config.CoderName << " PNG " << filters[f].second << " " << strategies[s].second << " " << levels[l] << ": "
+					<< ms / nRuns << "ms, " << png.size() << " bytes" << std::endl;
+			}
+		}
+	}
+
+	csv.close();
+}
+#endif
+
+#ifdef DSTREAM_ENABLE_WEBP
+template <typename T>
+void BenchmarkWebp(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 3;
+	std::ofstream csv(outputFolder + "/webp.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, false);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	std::pair<WebpSettings, std::string> presets[8] = {
+		{ WebpSettings::Fastest(), "Fastest" }, { WebpSettings::Balanced(), "Balanced" }, { WebpSettings::Smallest(), "Smallest" },
+		{ WebpSettings::NearLosslessPreset(80), "NearLossless80" }, { WebpSettings::NearLosslessPreset(60), "NearLossless60" },
+		{ WebpSettings::Lossy(95, 0), "Lossy95Fast" }, { WebpSettings::Lossy(95, 6), "Lossy95Slow" },
+		{ WebpSettings::LibwebpDefault(95), "LibwebpDefault95" }
+	};
+
+	// Threaded encoding, then the same file decoded on one thread and with threads
+	for (uint32_t p = 0; p < 8; p++)
+	{
+		for (uint32_t threaded = 0; threaded < 2; threaded++)
+		{
+			WebpSettings settings = presets[p].first;
+			settings.Threaded = threaded;
+
+			std::vector<uint8_t> webp;
+			double encodeMs = 0, decodeMs[2] = { 0, 0 };
+			for (uint32_t r = 0; r < nRuns; r++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				ImageWriter::EncodeWEBP(config.EncodedBuffer, config.Width, config.Height, settings, webp);
+				encodeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+				for (uint32_t decodeThreaded = 0; decodeThreaded < 2; decodeThreaded++)
+				{
+					start = std::chrono::high_resolution_clock::now();
+					ImageReader::DecodeWEBP(webp.data(), webp.size(), config.ColorBuffer, nElements * 3, false, decodeThreaded);
+					decodeMs[decodeThreaded] += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				}
+			}
+
+			coder.Decode(config.DecodedData, (Color*)config.ColorBuffer, nElements);
+			ErrorStats errors = GetErrorStats(config.DecodedData, config.QuantizedData, nElements);
+
+			csv << config.CoderName << "," << presets[p].second << "," << threaded << "," << encodeMs / nRuns << "," << decodeMs[0] / nRuns << ","
+				<< decodeMs[1] / nRuns << "," << webp.size() << "," << errors.Max << "\n";
+			std::cout << config.CoderName << " WebP " << presets[p].second << (threaded ? " (threaded)" : "") << ": " << encodeMs / nRuns
+				<< "ms encode, " << decodeMs[0] / nRuns << "ms decode, " << decodeMs[1] / nRuns << "ms threaded decode, " << webp.size()
+				<< " bytes" << std::endl;
+		}
+	}
+
+	csv.close();
+}
+#endif
+
+template <typename T>
+void BenchmarkLossless(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t nRuns = 5;
+	std::ofstream csv(outputFolder + "/lossless.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, false);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	auto addResult = [&](const std::string& codec, double encodeMs, double decodeMs, size_t size) {
+		double mpixels = nElements / 1e6;
+		csv << config.CoderName << "," << codec << "," << encodeMs << "," << decodeMs << "," << mpixels / (encodeMs / 1000.0) << ","
+			<< mpixels / (decodeMs / 1000.0) << "," << size << "," << (memcmp(config.ColorBuffer, config.EncodedBuffer, nElements * 3) == 0) << "\n";
+		std::cout << config.CoderName << " " << codec << ": " << encodeMs << "ms encode, " << decodeMs << "ms decode, " << size << " bytes" << std::endl;
+	};
+
+	std::pair<DsqPredictor, std::string> predictors[2] = { { DsqPredictor::Left, "DSQ Left" }, { DsqPredictor::Gradient, "DSQ Gradient" } };
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		std::vector<uint8_t> dsq;
+		double encodeMs = 0, decodeMs = 0;
+		for (uint32_t r = 0; r < nRuns; r++)
+		{
+			int w, h;
+			auto start = std::chrono::high_resolution_clock::now();
+			DsqCodec::encode(config.EncodedBuffer, config.Width, config.Height, predictors[p].first, dsq);
+			auto mid = std::chrono::high_resolution_clock::now();
+			DsqCodec::decode(dsq.data(), dsq.size(), config.ColorBuffer, w, h);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			encodeMs += std::chrono::duration<double, std::milli>(mid - start).count();
+			decodeMs += std::chrono::duration<double, std::milli>(end - mid).count();
+		}
+		addResult(predictors[p].second, encodeMs / nRuns, decodeMs / nRuns, dsq.size());
+	}
+
+	// PNG goes through the file writer and reader, there's no in memory path for libpng
+	{
+		std::string pngPath = outputFolder + "/LosslessBaseline.png";
+		auto start = std::chrono::high_resolution_clock::now();
+		ImageWriter::WritePNG(pngPath, config.EncodedBuffer, config.Width, config.Height);
+		auto mid = std::chrono::high_resolution_clock::now();
+		ImageReader::ReadPNG(pngPath, config.ColorBuffer);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		addResult("PNG", std::chrono::duration<double, std::milli>(mid - start).count(), std::chrono::duration<double, std::milli>(end - mid).count(),
+			std::filesystem::file_size(pngPath));
+	}
+
+#ifdef DSTREAM_ENABLE_WEBP
+	{
+		std::vector<uint8_t> webp;
+		auto start = std::chrono::high_resolution_clock::now();
+		ImageWriter::EncodeWEBP(config.EncodedBuffer, config.Width, config.Height, WebpSettings::Fastest(), webp);
+		auto mid = std::chrono::high_resolution_clock::now();
+		ImageReader::DecodeWEBP(webp.data(), webp.size(), config.ColorBuffer, nElements * 3);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		addResult("WebP Lossless", std::chrono::duration<double, std::milli>(mid - start).count(), std::chrono::duration<double, std::milli>(end - mid).count(),
+			webp.size());
+	}
+#endif
+
+	csv.close();
+}
+
+// Standard and derived tables at the same qualities, to compare size against mean and max depth error
+template <typename T>
+void BenchmarkQuantTables(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	int qualities[6] = { 50, 70, 80, 90, 95, 100 };
+	std::ofstream csv(outputFolder + "/jpeg_quant.csv", std::ios::out | std::ios::app);
+	std::ofstream tablesCsv(outputFolder + "/quant_tables.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	std::array<float, 3> sensitivity = QuantTables::GetChannelSensitivity(coder, (Color*)config.EncodedBuffer, nElements);
+	std::vector<std::array<unsigned int, 64>> tables = QuantTables::Derive(sensitivity);
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		tablesCsv << config.CoderName << "," << c << "," << sensitivity[c];
+		for (uint32_t k = 0; k < 64; k++)
+			tablesCsv << "," << tables[c][k];
+		tablesCsv << "\n";
+	}
+
+	for (uint32_t custom = 0; custom < 2; custom++)
+	{
+		for (int quality : qualities)
+		{
+			int length = RoundTripJpeg(config, quality, custom ? tables : std::vector<std::array<unsigned int, 64>>());
+			coder.Decode(config.DecodedData, (Color*)config.ColorBuffer, nElements);
+
+			ErrorStats errors = GetErrorStats(config.DecodedData, config.QuantizedData, nElements);
+			csv << config.CoderName << "," << (custom ? "Derived" : "Standard") << "," << quality << "," << length << ","
+				<< errors.Avg << "," << errors.Max << "\n";
+		}
+	}
+}
+
+// RGB 4:4:4 against 4:2:0 output, with the colours converted to YCbCr as usual and with the coarse channel stored as luma
+template <typename T>
+void BenchmarkLumaLayout(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	int qualities[6] = { 50, 70, 80, 90, 95, 100 };
+	const char* layouts[3] = { "RGB 4:4:4", "YCbCr 4:2:0", "Luma 4:2:0" };
+	std::ofstream csv(outputFolder + "/jpeg_luma.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	std::vector<Color> lumaLayout(nElements);
+	uint8_t coarseChannel = coder.GetCoarseChannel();
+	LumaLayout::Apply(lumaLayout.data(), (Color*)config.EncodedBuffer, nElements, coarseChannel);
+
+	for (uint32_t l = 0; l < 3; l++)
+	{
+		for (int quality : qualities)
+		{
+			JpegEncoder encoder;
+			JpegDecoder decoder;
+			uint8_t* source = config.EncodedBuffer;
+			if (l == 0)
+			{
+				encoder.setJpegColorSpace(JCS_RGB);
+				decoder.setJpegColorSpace(JCS_RGB);
+			}
+			else if (l == 2)
+			{
+				encoder.setColorSpace(JCS_YCbCr, 3);
+				decoder.setColorSpace(JCS_YCbCr);
+				decoder.setJpegColorSpace(JCS_YCbCr);
+				decoder.setFancyUpsampling(false);
+				source = (uint8_t*)lumaLayout.data();
+			}
+			encoder.setChromaSubsampling(l > 0);
+			encoder.setQuality(quality);
+
+			uint8_t* jpeg = nullptr;
+			int length = 0, w, h;
+			encoder.encode(source, config.Width, config.Height, jpeg, length);
+			decoder.decodeNonAlloc(jpeg, length, config.ColorBuffer, w, h);
+			free(jpeg);
+
+			if (l == 2)
+				LumaLayout::Revert((Color*)config.ColorBuffer, (Color*)config.ColorBuffer, nElements, coarseChannel);
+			coder.Decode(config.DecodedData, (Color*)config.ColorBuffer, nElements);
+
+			ErrorStats errors = GetErrorStats(config.DecodedData, config.QuantizedData, nElements);
+			csv << config.CoderName << "," << layouts[l] << "," << quality << "," << length << ","
+				<< errors.Avg << "," << errors.Max << "\n";
+		}
+	}
+}
+
+// Byte budgets are fractions of the size at quality 90, searched with and without the subsampled estimate
+template <typename T>
+void BenchmarkRateControl(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	float budgets[3] = { 0.25f, 0.5f, 0.75f };
+	uint32_t maxErrors[3] = { 64, 256, 1024 };
+	std::ofstream csv(outputFolder + "/rate_control.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	RateControl rateControl;
+	std::vector<uint8_t> out;
+	rateControl.setQualityRange(90, 90);
+	rateControl.fitSize(config.EncodedBuffer, config.Width, config.Height, SIZE_MAX, out);
+	size_t referenceSize = out.size();
+	rateControl.setQualityRange(1, 100);
+
+	for (int step : { 0, 4 })
+	{
+		rateControl.setEstimateStep(step);
+		for (float budget : budgets)
+		{
+			size_t maxBytes = referenceSize * budget;
+			auto start = std::chrono::high_resolution_clock::now();
+			bool met = rateControl.fitSize(config.EncodedBuffer, config.Width, config.Height, maxBytes, out);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			csv << config.CoderName << ",Size," << maxBytes << "," << step << "," << met << "," << rateControl.getQuality() << ","
+				<< out.size() << ",," << rateControl.getEncodes() << "," << std::chrono::duration<double, std::milli>(end - start).count() << "\n";
+		}
+	}
+
+	auto decode = [&](const uint8_t* colors, uint16_t* depth, uint32_t n) { coder.Decode(depth, (Color*)colors, n); };
+	for (uint32_t maxError : maxErrors)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		bool met = rateControl.fitError(config.EncodedBuffer, config.Width, config.Height, config.QuantizedData, maxError, decode, out);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		csv << config.CoderName << ",Error," << maxError << ",0," << met << "," << rateControl.getQuality() << "," << out.size() << ","
+			<< rateControl.getMaxError() << "," << rateControl.getEncodes() << "," << std::chrono::duration<double, std::milli>(end - start).count() << "\n";
+	}
+}
+
+// Tunes every tile of a 4x4 grid, terrain often changes enough across a depthmap to change the best coder
+void BenchmarkAutotuner(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t tileWidth = config.Width / 4, tileHeight = config.Height / 4;
+	std::ofstream csv(outputFolder + "/autotune.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+
+	Autotuner tuner;
+	tuner.setTimeBudget(0);
+	for (uint32_t ty = 0; ty < 4; ty++)
+	{
+		for (uint32_t tx = 0; tx < 4; tx++)
+		{
+			const uint16_t* tile = config.QuantizedData + ty * tileHeight * config.Width + tx * tileWidth;
+			TileHeader best = tuner.tune(tile, tileWidth, tileHeight, config.Width);
+
+			for (const AutotuneEvaluation& e : tuner.getEvaluations())
+			{
+				bool chosen = e.Header.Coder == best.Coder && e.Header.AlgoBits == best.AlgoBits;
+				csv << ty * 4 + tx << "," << TileHeader::GetCoderName(e.Header.Coder) << "," << (int)e.Header.AlgoBits << "," << e.Size << ","
+					<< e.BitsPerPixel << "," << e.Rmse << "," << e.MaxError << "," << e.Cost << "," << e.Ms << "," << chosen << "\n";
+			}
+			std::cout << "Tile " << ty * 4 + tx << ": " << TileHeader::GetCoderName(best.Coder) << " " << (int)best.AlgoBits << std::endl;
+		}
+	}
+}
+
+// Global against per tile depth ranges, errors are in the units of the depthmap after dequantization. Tile size 0 is global
+template <typename T>
+void BenchmarkTiledQuantization(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	uint32_t tileSizes[4] = { 0, 256, 128, 64 };
+	std::ofstream csv(outputFolder + "/tiled_quantization.csv", std::ios::out | std::ios::app);
+
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	std::vector<float> dequantized(nElements);
+	std::vector<uint8_t> mask(nElements);
+	DepthMask::Build(mask.data(), config.RawData, nElements);
+
+	for (uint32_t tileSize : tileSizes)
+	{
+		TileRanges ranges;
+		if (tileSize == 0)
+		{
+			ranges.TileSize = std::max(config.Width, config.Height);
+			ranges.Ranges = { DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements) };
+		}
+		else
+		{
+			ranges.TileSize = tileSize;
+			DepthProcessing::QuantizeTiled(config.QuantizedData, config.RawData, config.Width, config.Height, tileSize, 16, ranges.Ranges);
+		}
+		// The decoder only gets the serialized ranges
+		std::vector<uint8_t> header;
+		ranges.Write(header);
+		TileRanges readRanges;
+		if (readRanges.Read(header.data(), header.size()) != header.size() || !readRanges.Covers(config.Width, config.Height))
+		{
+			std::cerr << "Invalid tile ranges header, tile size " << tileSize << std::endl;
+			continue;
+		}
+
+		coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+		int length = RoundTripJpeg(config);
+		coder.DecodeToDepth(dequantized.data(), (Color*)config.ColorBuffer, config.Width, 0, config.Height, readRanges);
+
+		ErrorStats errors = GetErrorStats(dequantized.data(), config.RawData, nElements, mask.data());
+		csv << config.CoderName << "," << tileSize << "," << length << "," << header.size() << ","
+			<< errors.Rmse << "," << errors.Max << "\n";
+	}
+}
+
+template <typename T>
+void BenchmarkLazyTables(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	std::ofstream csv(outputFolder + "/latency.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	{
+		StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, false);
+		coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+	}
+
+	for (uint32_t lazy = 0; lazy < 2; lazy++)
+	{
+		// First frame: tables are created and used immediately, second frame: steady state
+		auto start = std::chrono::high_resolution_clock::now();
+		StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true, TableLayout::Linear, lazy);
+		coder.Decode(config.DecodedData, (Color*)config.EncodedBuffer, nElements);
+		auto first = std::chrono::high_resolution_clock::now();
+		coder.Decode(config.DecodedData, (Color*)config.EncodedBuffer, nElements);
+		auto second = std::chrono::high_resolution_clock::now();
+
+		double firstMs = std::chrono::duration<double, std::milli>(first - start).count();
+		double secondMs = std::chrono::duration<double, std::milli>(second - first).count();
+		csv << config.CoderName << "," << (lazy ? "Lazy" : "Full") << "," << firstMs << "," << secondMs << "\n";
+		std::cout << config.CoderName << (lazy ? " lazy" : " full") << " tables, first frame: " << firstMs << "ms, next: " << secondMs << "ms" << std::endl;
+	}
+
+	csv.close();
+}
+
+template <typename T>
+void BenchmarkDecodeToDepth(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	std::ofstream csv(outputFolder + "/decode_depth.csv", std::ios::out | std::ios::app);
+
+	DepthRange range = DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	std::vector<uint8_t> mask(nElements);
+	DepthMask::Build(mask.data(), config.RawData, nElements);
+
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	std::vector<float> separate(nElements), fused(nElements);
+	std::vector<Half> half(nElements);
+	const uint32_t nRuns = 10;
+
+	auto time = [&](auto&& decode) {
+		decode();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < nRuns; i++)
+			decode();
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / nRuns;
+	};
+
+	double separateMs = time([&]() {
+		coder.Decode(config.DecodedData, (Color*)config.EncodedBuffer, nElements);
+		DepthProcessing::Dequantize(separate.data(), config.DecodedData, nElements, range, mask.data());
+	});
+	double fusedMs = time([&]() { coder.DecodeToDepth(fused.data(), (Color*)config.EncodedBuffer, nElements, range, mask.data()); });
+	double halfMs = time([&]() { coder.DecodeToDepth(half.data(), (Color*)config.EncodedBuffer, nElements, range, mask.data()); });
+
+	// NaN != NaN, compare the bits
+	bool equal = memcmp(separate.data(), fused.data(), nElements * sizeof(float)) == 0;
+	double halfError = 0;
+	for (uint32_t i = 0; i < nElements; i++)
+		if (mask[i])
+			halfError = std::max(halfError, (double)std::abs(half[i].ToFloat() - fused[i]));
+
+	csv << config.CoderName << "," << separateMs << "," << fusedMs << "," << halfMs << "," << equal << "," << halfError << "\n";
+	std::cout << config.CoderName << " decode to depth, separate: " << separateMs << "ms, fused: " << fusedMs << "ms, half: " << halfMs << "ms" << std::endl;
+}
+
+template <typename T>
+void BenchmarkNoData(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	const uint32_t nearDistance = 4;
+	std::ofstream csv(outputFolder + "/nodata.csv", std::ios::out | std::ios::app);
+
+	// Punch holes in the depth map: a block in the middle and scattered smaller ones
+	std::vector<float> holed(config.RawData, config.RawData + nElements);
+	for (uint32_t y = 0; y < config.Height; y++)
+	{
+		for (uint32_t x = 0; x < config.Width; x++)
+		{
+			bool center = x > config.Width / 3 && x < config.Width / 2 && y > config.Height / 3 && y < config.Height / 2;
+			bool scattered = (x / 16 + y / 16 * 7) % 23 == 0 && x % 16 < 10 && y % 16 < 10;
+			if (center || scattered)
+				holed[y * config.Width + x] = std::numeric_limits<float>::quiet_NaN();
+		}
+	}
+
+	std::vector<uint8_t> mask(nElements), near(nElements), tmp(nElements);
+	DepthMask::Build(mask.data(), holed.data(), nElements);
+	std::vector<uint8_t> maskData;
+	DepthMask::Write(mask.data(), nElements, maskData);
+
+	// Valid values within nearDistance of a hole, separable dilation of the no-data values
+	for (uint32_t y = 0; y < config.Height; y++)
+		for (uint32_t x = 0; x < config.Width; x++)
+		{
+			uint32_t x0 = x > nearDistance ? x - nearDistance : 0, x1 = std::min(config.Width - 1, x + nearDistance);
+			tmp[y * config.Width + x] = 0;
+			for (uint32_t i = x0; i <= x1; i++)
+				tmp[y * config.Width + x] |= !mask[y * config.Width + i];
+		}
+	for (uint32_t y = 0; y < config.Height; y++)
+		for (uint32_t x = 0; x < config.Width; x++)
+		{
+			uint32_t y0 = y > nearDistance ? y - nearDistance : 0, y1 = std::min(config.Height - 1, y + nearDistance);
+			near[y * config.Width + x] = 0;
+			for (uint32_t i = y0; i <= y1; i++)
+				near[y * config.Width + x] |= tmp[i * config.Width + x];
+			near[y * config.Width + x] &= mask[y * config.Width + x];
+		}
+
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	std::vector<float> decoded(nElements);
+
+	for (uint32_t filled = 0; filled < 2; filled++)
+	{
+		// Without filling, no-data values are quantized to 0
+		DepthRange range = DepthProcessing::Quantize(config.QuantizedData, holed.data(), 16, nElements);
+		if (filled)
+			DepthMask::Fill(config.QuantizedData, mask.data(), config.Width, config.Height);
+		coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+		int length = RoundTripJpeg(config);
+		coder.DecodeToDepth(decoded.data(), (Color*)config.ColorBuffer, nElements, range, mask.data());
+
+		ErrorStats errors = GetErrorStats(decoded.data(), holed.data(), nElements, mask.data());
+		ErrorStats nearErrors = GetErrorStats(decoded.data(), holed.data(), nElements, near.data());
+		csv << config.CoderName << "," << (filled ? "Filled" : "Zero") << "," << length << "," << maskData.size() << ","
+			<< errors.Rmse << "," << errors.Max << "," << nearErrors.Rmse << "," << nearErrors.Max << "\n";
+	}
+}
+
+template <typename T>
+void BenchmarkPreview(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	std::ofstream csv(outputFolder + "/preview.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	JpegEncoder encoder;
+	encoder.setJpegColorSpace(JCS_RGB);
+	encoder.setQuality(90);
+	uint8_t* jpeg = nullptr;
+	int length = 0;
+	encoder.encode(config.EncodedBuffer, config.Width, config.Height, jpeg, length);
+
+	for (int scale : { 1, 2, 4, 8 })
+	{
+		JpegDecoder decoder;
+		decoder.setJpegColorSpace(JCS_RGB);
+		decoder.setScale(scale);
+
+		int w, h;
+		auto start = std::chrono::high_resolution_clock::now();
+		decoder.decodeNonAlloc(jpeg, length, config.ColorBuffer, w, h);
+		coder.Decode(config.DecodedData, (Color*)config.ColorBuffer, w * h);
+		auto decoded = std::chrono::high_resolution_clock::now();
+		std::vector<uint16_t> raw(config.DecodedData, config.DecodedData + w * h);
+		DepthProcessing::RemoveSpikes(config.DecodedData, w, h);
+		auto cleaned = std::chrono::high_resolution_clock::now();
+
+		// Compared with the average of the block of original values, outliers fall out of the range of the block
+		// grown by half a block on every side
+		const int threshold = DepthProcessing::PreviewSpikeThreshold;
+		double rawSum = 0, cleanSum = 0, maxError = 0;
+		uint32_t rawOutliers = 0, cleanOutliers = 0;
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				double sum = 0;
+				uint32_t count = 0;
+				int min = 65535, max = 0;
+				for (int by = std::max(0, y * scale - scale / 2); by < std::min<int>(config.Height, (y + 1) * scale + scale / 2); by++)
+				{
+					for (int bx = std::max(0, x * scale - scale / 2); bx < std::min<int>(config.Width, (x + 1) * scale + scale / 2); bx++)
+					{
+						uint16_t v = config.QuantizedData[by * config.Width + bx];
+						min = std::min<int>(min, v);
+						max = std::max<int>(max, v);
+						if (by >= y * scale && by < (y + 1) * scale && bx >= x * scale && bx < (x + 1) * scale)
+						{
+							sum += v;
+							count++;
+						}
+					}
+				}
+
+				double reference = sum / count;
+				uint16_t before = raw[y * w + x], after = config.DecodedData[y * w + x];
+				rawSum += (before - reference) * (before - reference);
+				cleanSum += (after - reference) * (after - reference);
+				maxError = std::max(maxError, std::abs(after - reference));
+				rawOutliers += before + threshold < min || before > max + threshold;
+				cleanOutliers += after + threshold < min || after > max + threshold;
+			}
+		}
+
+		double decodeMs = std::chrono::duration<double, std::milli>(decoded - start).count();
+		double cleanupMs = std::chrono::duration<double, std::milli>(cleaned - decoded).count();
+		csv << config.CoderName << "," << scale << "," << w << "," << h << "," << decodeMs << "," << cleanupMs << ","
+			<< std::sqrt(rawSum / (w * h)) << "," << std::sqrt(cleanSum / (w * h)) << "," << maxError << ","
+			<< rawOutliers << "," << cleanOutliers << "\n";
+	}
+
+	free(jpeg);
+}
+
+template <typename T>
+void BenchmarkRegion(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	std::ofstream csv(outputFolder + "/roi.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	coder.Encode((Color*)config.EncodedBuffer, config.QuantizedData, nElements);
+
+	// RGB and luma priority 4:2:0, whose chroma is replicated in region and full decodes alike
+	uint8_t coarseChannel = coder.GetCoarseChannel();
+	std::vector<Color> layout(nElements);
+	LumaLayout::Apply(layout.data(), (Color*)config.EncodedBuffer, nElements, coarseChannel);
+	std::vector<uint16_t> full(nElements);
+
+	for (uint32_t luma = 0; luma < 2; luma++)
+	{
+		JpegEncoder encoder;
+		if (luma)
+		{
+			encoder.setColorSpace(JCS_YCbCr, 3);
+			encoder.setJpegColorSpace(JCS_YCbCr);
+			encoder.setChromaSubsampling(true);
+		}
+		else
+			encoder.setJpegColorSpace(JCS_RGB);
+		encoder.setQuality(90);
+
+		uint8_t* jpeg = nullptr;
+		int length = 0;
+		encoder.encode(luma ? (uint8_t*)layout.data() : config.EncodedBuffer, config.Width, config.Height, jpeg, length);
+
+		auto setupDecoder = [&](JpegDecoder& decoder) {
+			if (luma)
+			{
+				decoder.setColorSpace(JCS_YCbCr);
+				decoder.setJpegColorSpace(JCS_YCbCr);
+				decoder.setFancyUpsampling(false);
+			}
+			else
+				decoder.setJpegColorSpace(JCS_RGB);
+		};
+
+		// Every region is compared to a full decode of the image
+		{
+			JpegDecoder decoder;
+			setupDecoder(decoder);
+			int fullWidth, fullHeight;
+			decoder.decodeNonAlloc(jpeg, length, config.ColorBuffer, fullWidth, fullHeight);
+			if (luma)
+				LumaLayout::Revert((Color*)config.ColorBuffer, (Color*)config.ColorBuffer, nElements, coarseChannel);
+			coder.Decode(full.data(), (Color*)config.ColorBuffer, nElements);
+		}
+
+		// Windows centred in the image, 0 is the whole frame
+		for (uint32_t size : { 0u, 512u, 256u, 64u })
+		{
+			uint32_t w = size ? std::min(size, config.Width) : config.Width, h = size ? std::min(size, config.Height) : config.Height;
+			uint32_t x = (config.Width - w) / 2, y = (config.Height - h) / 2;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			JpegDecoder decoder;
+			setupDecoder(decoder);
+			// The colours of the window are left where they are in the frame and the depth goes to a padded buffer, so that
+			// neither stride is the width of the window
+			Color* colors = (Color*)config.ColorBuffer + y * config.Width + x;
+			uint32_t depthStride = w + 7;
+			std::vector<uint16_t> region(depthStride * h);
+			decoder.decodeRegion(jpeg, length, x, y, w, h, (uint8_t*)colors, config.Width * 3);
+			for (uint32_t i = 0; luma && i < h; i++)
+				LumaLayout::Revert(colors + i * config.Width, colors + i * config.Width, w, coarseChannel);
+			coder.DecodeRegion(region.data(), depthStride, colors, config.Width, w, h);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			uint32_t mismatches = 0;
+			for (uint32_t i = 0; i < h; i++)
+				for (uint32_t j = 0; j < w; j++)
+					mismatches += region[i * depthStride + j] != full[(y + i) * config.Width + x + j];
+			if (mismatches > 0)
+				std::cout << config.CoderName << " region " << w << "x" << h << " differs from the full decode in " << mismatches << " values" << std::endl;
+
+			csv << config.CoderName << "," << (luma ? "Luma 4:2:0" : "RGB") << "," << w << "," << h << "," << x << "," << y << ","
+				<< ms << "," << mismatches << "\n";
+		}
+
+		free(jpeg);
+	}
+}
+
+template <typename T>
+void BenchmarkImageView(BenchmarkConfig& config)
+{
+	uint32_t nElements = config.Width * config.Height;
+	const char* formatNames[] = { "RGB", "BGR", "RGBA", "BGRA", "Planar" };
+	std::ofstream csv(outputFolder + "/image_view.csv", std::ios::out | std::ios::app);
+
+	DepthProcessing::Quantize(config.QuantizedData, config.RawData, 16, nElements);
+	StreamCoder<T> coder(config.Enlarge, config.Interpolate, config.AlgoBits, config.ChannelDistribution, true);
+	std::vector<Color> packed(nElements);
+	std::vector<uint16_t> viewDecoded(nElements);
+
+	// Every format should decode to exactly what the packed RGB path decodes
+	std::vector<uint16_t> reference(nElements);
+	coder.Encode(packed.data(), config.QuantizedData, nElements);
+	coder.Decode(reference.data(), packed.data(), nElements);
+
+	for (uint32_t f = 0; f <= (uint32_t)PixelFormat::Planar; f++)
+	{
+		// Rows padded to 64 bytes, like the ones of a GPU readback
+		PixelFormat format = (PixelFormat)f;
+		size_t stride = ((size_t)config.Width * ImageView::GetPixelSize(format) + 63) & ~(size_t)63;
+		std::vector<uint8_t> buffer(stride * config.Height * (format == PixelFormat::Planar ? 3 : 1));
+		ImageView view = format == PixelFormat::Planar ?
+			ImageView::Planar(buffer.data(), buffer.data() + stride * config.Height, buffer.data() + 2 * stride * config.Height, config.Width, config.Height, stride) :
+			ImageView::Interleaved(buffer.data(), config.Width, config.Height, format, stride);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		coder.Encode(view, config.QuantizedData);
+		auto encoded = std::chrono::high_resolution_clock::now();
+		coder.Decode(viewDecoded.data(), view);
+		auto decoded = std::chrono::high_resolution_clock::now();
+
+		// Repacking the frame to RGB first, as callers had to
+		for (uint32_t y = 0; y < config.Height; y++)
+			view.Load(0, y, config.Width, packed.data() + y * config.Width);
+		coder.Decode(config.DecodedData, packed.data(), nElements);
+		auto repacked = std::chrono::high_resolution_clock::now();
+
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < nElements; i++)
+			mismatches += viewDecoded[i] != reference[i];
+		if (mismatches)
+			std::cout << config.CoderName << " ImageView " << formatNames[f] << ": " << mismatches << " values differ from the packed RGB decode" << std::endl;
+
+		csv << config.CoderName << "," << formatNames[f] << "," << stride << ","
+			<< std::chrono::duration<double, std::milli>(encoded - start).count() << ","
+			<< std::chrono::duration<double, std::milli>(decoded - encoded).count() << ","
+			<< std::chrono::duration<double, std::milli>(repacked - decoded).count() << "," << mismatches << "\n";
+	}
+}
+
 int main(int argc, char** argv)
 {
 	DSTR_PROFILE_BEGIN_SESSION("Runtime", "Profile-Runtime.json");
@@ -461,6 +1527,179 @@ int main(int argc, char** argv)
 		folders.pop_back();
 	}
 
+	// Native depth codec baseline
+	{
+		std::ofstream timeCsv(outputFolder + "/depthcodec.csv");
+		timeCsv << "Max Error, Encode Time (ms), Decode Time (ms), Size (bytes)\n";
+		timeCsv.close();
+
+		AddFolderLevel("DepthCodec", -1, folders);
+
+		BenchmarkConfig config;
+		config.Width = dmData.Width;
+		config.Height = dmData.Height;
+		config.ColorBuffer = colorBuffer;
+		config.RawData = rawData;
+		config.QuantizedData = originalData;
+		config.DecodedData = decodedData;
+		config.CurrentPath = GetPathFromComponents(folders);
+		BenchmarkDepthCodec(config);
+
+		folders.pop_back();
+	}
+
+	// Decoding table layouts and creation
+	{
+		std::ofstream layoutCsv(outputFolder + "/layouts.csv");
+		layoutCsv << "Coder, Layout, Decode Time (ms), Cache Misses, L1D Read Misses, dTLB Read Misses\n";
+		layoutCsv.close();
+
+		BenchmarkConfig config;
+		config.Width = dmData.Width;
+		config.Height = dmData.Height;
+		config.ColorBuffer = colorBuffer;
+		config.RawData = rawData;
+		config.QuantizedData = originalData;
+		config.EncodedBuffer = encodedData;
+		config.DecodedData = decodedData;
+		config.Enlarge = false;
+		config.Interpolate = true;
+		config.OutputFormat = ImageFormat::JPG;
+
+		Run(config, "Hilbert", 5, BenchmarkTableLayouts<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkTableLayouts<Split2>);
+
+		// Batched table decode
+		std::ofstream gatherCsv(outputFolder + "/gather.csv");
+		gatherCsv << "Coder, Scalar Decode (ms), Batched Decode (ms), Mismatches\n";
+		gatherCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkTableGather<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkTableGather<Split2>);
+
+		// Lazy tables
+		std::ofstream latencyCsv(outputFolder + "/latency.csv");
+		latencyCsv << "Coder, Tables, First Frame (ms), Next Frame (ms)\n";
+		latencyCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkLazyTables<Hilbert>);
+
+		// Quantization tables derived from the channel sensitivity of each coder
+		std::ofstream quantCsv(outputFolder + "/jpeg_quant.csv");
+		quantCsv << "Coder, Tables, Quality, Size (bytes), Avg Error, Max Error\n";
+		quantCsv.close();
+		std::ofstream tablesCsv(outputFolder + "/quant_tables.csv");
+		tablesCsv << "Coder, Channel, Sensitivity, Table (natural order)\n";
+		tablesCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkQuantTables<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkQuantTables<Split2>);
+		Run(config, "Packed2", 4, BenchmarkQuantTables<Packed2>);
+
+		// Chroma subsampled JPEG with the luma priority layout
+		std::ofstream lumaCsv(outputFolder + "/jpeg_luma.csv");
+		lumaCsv << "Coder, Layout, Quality, Size (bytes), Avg Error, Max Error\n";
+		lumaCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkLumaLayout<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkLumaLayout<Split2>);
+		Run(config, "Packed2", 4, BenchmarkLumaLayout<Packed2>);
+
+		// Quality search for a byte budget or a maximum error
+		std::ofstream rateCsv(outputFolder + "/rate_control.csv");
+		rateCsv << "Coder, Target, Value, Estimate Step, Met, Quality, Size (bytes), Max Error, Encodes, Time (ms)\n";
+		rateCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkRateControl<Hilbert>);
+		Run(config, "Packed2", 4, BenchmarkRateControl<Packed2>);
+
+		// Per tile coder selection
+		std::ofstream autotuneCsv(outputFolder + "/autotune.csv");
+		autotuneCsv << "Tile, Coder, Bits, Size (bytes), Bits per pixel, RMSE, Max Error, Cost, Time (ms), Chosen\n";
+		autotuneCsv.close();
+
+		BenchmarkAutotuner(config);
+
+		// Depth ranges per tile
+		std::ofstream tiledCsv(outputFolder + "/tiled_quantization.csv");
+		tiledCsv << "Coder, Tile Size, Size (bytes), Header Size (bytes), RMSE, Max Error\n";
+		tiledCsv.close();
+
+		Run(config, "Packed2", 4, BenchmarkTiledQuantization<Packed2>);
+		Run(config, "Split2", 8, BenchmarkTiledQuantization<Split2>);
+
+		// No-data holes
+		std::ofstream noDataCsv(outputFolder + "/nodata.csv");
+		noDataCsv << "Coder, No-data, Size (bytes), Mask Size (bytes), RMSE, Max Error, RMSE Near Holes, Max Error Near Holes\n";
+		noDataCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkNoData<Hilbert>);
+		Run(config, "Packed2", 4, BenchmarkNoData<Packed2>);
+
+		// Reduced resolution previews
+		std::ofstream previewCsv(outputFolder + "/preview.csv");
+		previewCsv << "Coder, Scale, Width, Height, Decode Time (ms), Cleanup Time (ms), RMSE, Cleaned RMSE, Cleaned Max Error, Outliers, Cleaned Outliers\n";
+		previewCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkPreview<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkPreview<Split2>);
+
+		// Region of interest decoding
+		std::ofstream roiCsv(outputFolder + "/roi.csv");
+		roiCsv << "Coder, Layout, Width, Height, X, Y, Time (ms), Mismatches\n";
+		roiCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkRegion<Hilbert>);
+
+		// Pixel formats and strides
+		std::ofstream viewCsv(outputFolder + "/image_view.csv");
+		viewCsv << "Coder, Format, Stride (bytes), Encode Time (ms), Decode Time (ms), Repack + Decode Time (ms), Mismatches\n";
+		viewCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkImageView<Hilbert>);
+
+		// Decoding straight to metric depth
+		std::ofstream depthCsv(outputFolder + "/decode_depth.csv");
+		depthCsv << "Coder, Separate Time (ms), Fused Time (ms), Half Time (ms), Equal, Max Half Error\n";
+		depthCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkDecodeToDepth<Hilbert>);
+		Run(config, "Packed2", 4, BenchmarkDecodeToDepth<Packed2>);
+
+		// Parallel JPEG encoding
+		std::ofstream parallelCsv(outputFolder + "/jpeg_parallel.csv");
+		parallelCsv << "Coder, Encoder, Threads, Encode Time (ms), Size (bytes), Decode Mismatches\n";
+		parallelCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkParallelJpeg<Hilbert>);
+
+#ifdef DSTREAM_ENABLE_ZIP
+		// PNG compression settings
+		std::ofstream pngCsv(outputFolder + "/png.csv");
+		pngCsv << "Coder, Writer, Filter, Strategy, Level, Encode Time (ms), Size (bytes)\n";
+		pngCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkPng<Hilbert>);
+#endif
+
+		// Lossless codecs
+		std::ofstream losslessCsv(outputFolder + "/lossless.csv");
+		losslessCsv << "Coder, Codec, Encode Time (ms), Decode Time (ms), Encode MPixel/s, Decode MPixel/s, Size (bytes), Exact\n";
+		losslessCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkLossless<Hilbert>);
+		Run(config, "Split2", 8, BenchmarkLossless<Split2>);
+
+#ifdef DSTREAM_ENABLE_WEBP
+		// WebP presets
+		std::ofstream webpCsv(outputFolder + "/webp.csv");
+		webpCsv << "Coder, Preset, Threaded, Encode Time (ms), Decode Time (ms), Threaded Decode Time (ms), Size (bytes), Max Error\n";
+		webpCsv.close();
+
+		Run(config, "Hilbert", 5, BenchmarkWebp<Hilbert>);
+#endif
+	}
+
 	delete[] encodedData;
 	delete[] decodedData;
 	delete[] colorBuffer;
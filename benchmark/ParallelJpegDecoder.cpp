@@ -0,0 +1,185 @@
+#include "ParallelJpegDecoder.h"
+#include "JpegDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace DStream
+{
+	struct JpegLayout
+	{
+		size_t ScanStart = 0;
+		size_t HeightOffset = 0;
+		int Width = 0, Height = 0;
+		int Components = 0;
+		int RestartInterval = 0;
+		bool Baseline = false;
+		bool Subsampled = false;
+		int MaxH = 1, MaxV = 1;
+	};
+
+	static bool ParseHeaders(const uint8_t* data, size_t size, JpegLayout& layout)
+	{
+		if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+			return false;
+
+		size_t pos = 2;
+		while (pos + 4 <= size)
+		{
+			if (data[pos] != 0xFF)
+				return false;
+
+			uint8_t marker = data[pos + 1];
+			size_t length = (data[pos + 2] << 8) | data[pos + 3];
+			const uint8_t* segment = data + pos + 4;
+			if (pos + 2 + length > size)
+				return false;
+
+			if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+			{
+				layout.Baseline = marker == 0xC0 || marker == 0xC1;
+				layout.HeightOffset = pos + 5;
+				layout.Height = (segment[1] << 8) | segment[2];
+				layout.Width = (segment[3] << 8) | segment[4];
+				layout.Components = segment[5];
+
+				for (int c = 0; c < layout.Components; c++)
+				{
+					int h = segment[7 + c * 3] >> 4, v = segment[7 + c * 3] & 15;
+					layout.MaxH = std::max(layout.MaxH, h);
+					layout.MaxV = std::max(layout.MaxV, v);
+					if (c > 0 && (h != (segment[7] >> 4) || v != (segment[7] & 15)))
+						layout.Subsampled = true;
+				}
+			}
+			else if (marker == 0xDD)
+				layout.RestartInterval = (segment[0] << 8) | segment[1];
+			else if (marker == 0xDA)
+			{
+				layout.ScanStart = pos + 2 + length;
+				return layout.Components > 0;
+			}
+
+			pos += 2 + length;
+		}
+		return false;
+	}
+
+	ParallelJpegDecoder::ParallelJpegDecoder(uint32_t nThreads) {
+		this->nThreads = nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void ParallelJpegDecoder::setColorSpace(J_COLOR_SPACE colorSpace) {
+		this->colorSpace = colorSpace;
+	}
+
+	void ParallelJpegDecoder::setJpegColorSpace(J_COLOR_SPACE colorSpace) {
+		this->jpegColorSpace = colorSpace;
+	}
+
+	void ParallelJpegDecoder::setFancyUpsampling(bool fancy) {
+		fancyUpsampling = fancy;
+	}
+
+	bool ParallelJpegDecoder::decodeSerial(const uint8_t* data, size_t size, uint8_t* buffer, int& width, int& height, const BandCallback& onBand) {
+		JpegDecoder decoder;
+		decoder.setColorSpace(colorSpace);
+		decoder.setJpegColorSpace(jpegColorSpace);
+		decoder.setFancyUpsampling(fancyUpsampling);
+
+		bandCount = 1;
+		if (!decoder.decodeNonAlloc(data, size, buffer, width, height))
+			return false;
+		if (onBand)
+			onBand(0, height);
+		return true;
+	}
+
+	bool ParallelJpegDecoder::decode(const uint8_t* data, size_t size, uint8_t* buffer, int& width, int& height, const BandCallback& onBand) {
+		JpegLayout layout;
+		if (!ParseHeaders(data, size, layout) || !layout.Baseline || layout.Subsampled || layout.RestartInterval == 0 || nThreads < 2)
+			return decodeSerial(data, size, buffer, width, height, onBand);
+
+		int mcuWidth = 8 * layout.MaxH, mcuHeight = 8 * layout.MaxV;
+		int mcusPerRow = (layout.Width + mcuWidth - 1) / mcuWidth;
+		int mcuRows = (layout.Height + mcuHeight - 1) / mcuHeight;
+		int interval = layout.RestartInterval;
+		int nIntervals = (mcusPerRow * mcuRows + interval - 1) / interval;
+
+		// Start of the data of every interval
+		std::vector<size_t> starts = { layout.ScanStart };
+		size_t scanEnd = size;
+		for (size_t i = layout.ScanStart; i + 1 < size; i++) {
+			if (data[i] != 0xFF || data[i + 1] == 0x00 || data[i + 1] == 0xFF)
+				continue;
+			if (data[i + 1] >= 0xD0 && data[i + 1] <= 0xD7)
+				starts.push_back(i + 2);
+			else {
+				scanEnd = i;
+				break;
+			}
+			i++;
+		}
+		if ((int)starts.size() != nIntervals)
+			return decodeSerial(data, size, buffer, width, height, onBand);
+
+		// Bands can only start on intervals that start an MCU row, which happens every groupIntervals intervals
+		int groupIntervals = mcusPerRow / std::gcd(interval, mcusPerRow);
+		int groupRows = groupIntervals * interval / mcusPerRow;
+		int nGroups = (mcuRows + groupRows - 1) / groupRows;
+		int nBands = std::min<int>(nThreads, nGroups);
+		if (nBands < 2)
+			return decodeSerial(data, size, buffer, width, height, onBand);
+		int bandGroups = (nGroups + nBands - 1) / nBands;
+		nBands = (nGroups + bandGroups - 1) / bandGroups;
+
+		width = layout.Width;
+		height = layout.Height;
+		bandCount = nBands;
+		size_t rowSize = (size_t)width * (colorSpace == JCS_GRAYSCALE ? 1 : 3);
+
+		std::vector<char> results(nBands, 0);
+		std::vector<std::thread> threads;
+		for (int b = 0; b < nBands; b++) {
+			threads.emplace_back([&, b]() {
+				int firstInterval = b * bandGroups * groupIntervals;
+				int lastInterval = std::min((b + 1) * bandGroups * groupIntervals, nIntervals);
+				int firstRow = b * bandGroups * groupRows * mcuHeight;
+				int rows = std::min(bandGroups * groupRows * mcuHeight, layout.Height - firstRow);
+
+				// Headers with the height of the band, then its intervals with restart markers numbered from 0
+				std::vector<uint8_t> band(data, data + layout.ScanStart);
+				band[layout.HeightOffset] = (uint8_t)(rows >> 8);
+				band[layout.HeightOffset + 1] = (uint8_t)(rows & 0xFF);
+
+				for (int i = firstInterval; i < lastInterval; i++) {
+					size_t end = i + 1 < nIntervals ? starts[i + 1] - 2 : scanEnd;
+					if (i > firstInterval) {
+						band.push_back(0xFF);
+						band.push_back(0xD0 + ((i - firstInterval - 1) & 7));
+					}
+					band.insert(band.end(), data + starts[i], data + end);
+				}
+				band.push_back(0xFF);
+				band.push_back(0xD9);
+
+				JpegDecoder decoder;
+				decoder.setColorSpace(colorSpace);
+				decoder.setJpegColorSpace(jpegColorSpace);
+		decoder.setFancyUpsampling(fancyUpsampling);
+				int w, h;
+				results[b] = decoder.decodeNonAlloc(band.data(), band.size(), buffer + firstRow * rowSize, w, h) && h == rows;
+
+				if (results[b] && onBand)
+					onBand(firstRow, rows);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		return std::all_of(results.begin(), results.end(), [](char ok) { return ok != 0; });
+	}
+}
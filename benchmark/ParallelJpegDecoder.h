@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+
+#include <jpeglib.h>
+
+namespace DStream
+{
+	// Decodes JPEGs with restart markers on multiple threads. The scan is split at the restart markers that fall on
+	// MCU row boundaries, every band of rows becomes a small JPEG of its own and is decoded on a different thread.
+	// Files without restart markers, progressive or chroma subsampled ones (their upsampling looks at the rows of
+	// the neighbouring bands) are decoded on the calling thread.
+	class ParallelJpegDecoder
+	{
+	public:
+		// Called as soon as rows [firstRow, firstRow + nRows) are in the buffer, possibly from several threads at once
+		typedef std::function<void(int firstRow, int nRows)> BandCallback;
+
+		// 0 threads uses one per core
+		ParallelJpegDecoder(uint32_t nThreads = 0);
+
+		void setColorSpace(J_COLOR_SPACE space);
+		void setJpegColorSpace(J_COLOR_SPACE colorSpace);
+		// See JpegDecoder::setFancyUpsampling
+		void setFancyUpsampling(bool fancy);
+
+		// buffer must have room for width * height * components bytes
+		bool decode(const uint8_t* data, size_t size, uint8_t* buffer, int& width, int& height, const BandCallback& onBand = nullptr);
+		// Number of bands the last image was split in, 1 if it has been decoded serially
+		int getBandCount() const { return bandCount; }
+
+	private:
+		bool decodeSerial(const uint8_t* data, size_t size, uint8_t* buffer, int& width, int& height, const BandCallback& onBand);
+
+		uint32_t nThreads;
+		int bandCount = 0;
+
+		J_COLOR_SPACE colorSpace = JCS_RGB;
+		J_COLOR_SPACE jpegColorSpace = JCS_YCbCr;
+		bool fancyUpsampling = true;
+	};
+}
@@ -0,0 +1,141 @@
+#include "ParallelJpegEncoder.h"
+#include "JpegEncoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace DStream
+{
+	// Offset of the scan data, right after the SOS segment. Also returns the offset of the image height in SOF.
+	static size_t FindScanData(const uint8_t* data, size_t size, size_t& heightOffset)
+	{
+		size_t pos = 2;
+		while (pos + 4 <= size)
+		{
+			if (data[pos] != 0xFF)
+				return 0;
+
+			uint8_t marker = data[pos + 1];
+			size_t length = (data[pos + 2] << 8) | data[pos + 3];
+			if (marker >= 0xC0 && marker <= 0xC3)
+				heightOffset = pos + 5;
+			if (marker == 0xDA)
+				return pos + 2 + length;
+			pos += 2 + length;
+		}
+		return 0;
+	}
+
+	ParallelJpegEncoder::ParallelJpegEncoder(uint32_t nThreads) {
+		this->nThreads = nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void ParallelJpegEncoder::setColorSpace(J_COLOR_SPACE colorSpace, int numComponents) {
+		this->colorSpace = colorSpace;
+		this->numComponents = numComponents;
+	}
+
+	void ParallelJpegEncoder::setJpegColorSpace(J_COLOR_SPACE colorSpace) {
+		this->jpegColorSpace = colorSpace;
+	}
+
+	void ParallelJpegEncoder::setQuality(int quality) {
+		this->quality = quality;
+	}
+
+	void ParallelJpegEncoder::setChromaSubsampling(bool subsample) {
+		this->subsample = subsample;
+	}
+
+	void ParallelJpegEncoder::setQuantTables(const std::vector<std::array<unsigned int, 64>>& tables) {
+		this->quantTables = tables;
+	}
+
+	bool ParallelJpegEncoder::encode(uint8_t* img, int width, int height, std::vector<uint8_t>& out) {
+		int mcuHeight = (jpegColorSpace == JCS_YCbCr && subsample) ? 16 : 8;
+		int mcuRows = (height + mcuHeight - 1) / mcuHeight;
+		int nStrips = std::min<int>(nThreads, mcuRows);
+		int stripMcuRows = (mcuRows + nStrips - 1) / nStrips;
+		nStrips = (mcuRows + stripMcuRows - 1) / stripMcuRows;
+
+		std::vector<uint8_t*> buffers(nStrips, nullptr);
+		std::vector<int> lengths(nStrips, 0);
+		std::vector<std::thread> threads;
+		size_t rowSize = (size_t)width * numComponents;
+
+		for (int s = 0; s < nStrips; s++) {
+			threads.emplace_back([&, s]() {
+				int startRow = s * stripMcuRows * mcuHeight;
+				int rows = std::min(stripMcuRows * mcuHeight, height - startRow);
+
+				JpegEncoder encoder;
+				encoder.setColorSpace(colorSpace, numComponents);
+				encoder.setJpegColorSpace(jpegColorSpace);
+				encoder.setQuality(quality);
+				encoder.setChromaSubsampling(subsample);
+				encoder.setQuantTables(quantTables);
+				// Every strip must use the same Huffman tables
+				encoder.setOptimize(false);
+				encoder.setRestartRows(1);
+				encoder.encode(img + startRow * rowSize, width, rows, buffers[s], lengths[s]);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		bool ok = true;
+		size_t totalSize = 0;
+		for (int length : lengths)
+			totalSize += length;
+		out.clear();
+		out.reserve(totalSize);
+		uint32_t restart = 0;
+
+		for (int s = 0; s < nStrips && ok; s++) {
+			const uint8_t* data = buffers[s];
+			size_t size = lengths[s], heightOffset = 0;
+			size_t scanStart = data ? FindScanData(data, size, heightOffset) : 0;
+			if (scanStart == 0 || heightOffset == 0 || size < scanStart + 2) {
+				ok = false;
+				break;
+			}
+
+			if (s == 0) {
+				// Headers of the first strip, with the height of the whole image
+				out.insert(out.end(), data, data + scanStart);
+				out[heightOffset] = (uint8_t)(height >> 8);
+				out[heightOffset + 1] = (uint8_t)(height & 0xFF);
+			}
+			else {
+				out.push_back(0xFF);
+				out.push_back(0xD0 + (restart++ & 7));
+			}
+
+			// Scan data without EOI, restart markers are numbered from 0 in every strip
+			size_t pos = scanStart, scanEnd = size - 2;
+			while (pos < scanEnd) {
+				const uint8_t* marker = (const uint8_t*)memchr(data + pos, 0xFF, scanEnd - pos);
+				size_t next = marker ? marker - data : scanEnd;
+				out.insert(out.end(), data + pos, data + next);
+				if (next + 1 >= scanEnd)
+					break;
+
+				uint8_t code = data[next + 1];
+				out.push_back(0xFF);
+				out.push_back(code >= 0xD0 && code <= 0xD7 ? 0xD0 + (restart++ & 7) : code);
+				pos = next + 2;
+			}
+		}
+
+		if (ok) {
+			out.push_back(0xFF);
+			out.push_back(0xD9);
+		}
+
+		for (uint8_t* buffer : buffers)
+			free(buffer);
+		return ok;
+	}
+}
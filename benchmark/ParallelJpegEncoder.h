@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <array>
+#include <vector>
+
+#include <jpeglib.h>
+
+namespace DStream
+{
+	// Encodes horizontal strips of an image on different threads and stitches them into a single baseline JPEG.
+	// Strips are multiples of the MCU height and are encoded with a restart marker every MCU row and the standard
+	// Huffman tables, so that their entropy coded data can be concatenated with a RST marker in between.
+	// The result is the same file a single encoder would produce with the same settings.
+	class ParallelJpegEncoder
+	{
+	public:
+		// 0 threads uses one per core
+		ParallelJpegEncoder(uint32_t nThreads = 0);
+
+		void setColorSpace(J_COLOR_SPACE colorSpace, int numComponents);
+		void setJpegColorSpace(J_COLOR_SPACE colorSpace);
+		void setQuality(int quality);
+		void setChromaSubsampling(bool subsample);
+		void setQuantTables(const std::vector<std::array<unsigned int, 64>>& tables);
+
+		bool encode(uint8_t* img, int width, int height, std::vector<uint8_t>& out);
+
+	private:
+		uint32_t nThreads;
+
+		J_COLOR_SPACE colorSpace = JCS_RGB;
+		J_COLOR_SPACE jpegColorSpace = JCS_YCbCr;
+		int numComponents = 3;
+		bool subsample = false;
+		std::vector<std::array<unsigned int, 64>> quantTables;
+
+		int quality = 90;
+	};
+}
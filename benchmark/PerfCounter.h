@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace DStream
+{
+    enum class PerfEvent { CacheMisses = 0, L1DReadMisses, DTLBReadMisses };
+
+    // Hardware event counter. Only available on Linux through perf_event_open, on other platforms
+    // (or if the kernel doesn't allow user space profiling) Valid() returns false and Stop() returns -1
+    class PerfCounter
+    {
+    public:
+        PerfCounter(PerfEvent event)
+        {
+#ifdef __linux__
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            switch (event)
+            {
+            case PerfEvent::CacheMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            case PerfEvent::L1DReadMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case PerfEvent::DTLBReadMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            }
+
+            m_Fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        }
+
+        ~PerfCounter()
+        {
+#ifdef __linux__
+            if (m_Fd >= 0)
+                close(m_Fd);
+#endif
+        }
+
+        PerfCounter(const PerfCounter&) = delete;
+        void operator=(const PerfCounter&) = delete;
+
+        inline bool Valid() { return m_Fd >= 0; }
+
+        void Start()
+        {
+#ifdef __linux__
+            if (m_Fd < 0)
+                return;
+            ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        int64_t Stop()
+        {
+#ifdef __linux__
+            if (m_Fd < 0)
+                return -1;
+
+            int64_t count = 0;
+            ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_Fd, &count, sizeof(count)) != sizeof(count))
+                return -1;
+            return count;
+#else
+            return -1;
+#endif
+        }
+
+    private:
+        int m_Fd = -1;
+    };
+}
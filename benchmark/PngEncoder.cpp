@@ -0,0 +1,225 @@
+#ifdef DSTREAM_ENABLE_ZIP
+
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace DStream
+{
+	static const uint32_t WindowSize = 32768;
+
+	static inline uint8_t Paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	// Writes the filter type followed by the filtered row, prev is null for the first row
+	static void FilterRow(PngFilter filter, const uint8_t* row, const uint8_t* prev, uint32_t rowSize, uint32_t bpp, uint8_t* dest)
+	{
+		uint8_t* out = dest + 1;
+		dest[0] = (uint8_t)filter;
+
+		for (uint32_t i = 0; i < rowSize; i++)
+		{
+			int a = i >= bpp ? row[i - bpp] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+
+			switch (filter)
+			{
+			case PngFilter::Sub:		out[i] = row[i] - a; break;
+			case PngFilter::Up:			out[i] = row[i] - b; break;
+			case PngFilter::Average:	out[i] = row[i] - ((a + b) >> 1); break;
+			case PngFilter::Paeth:		out[i] = row[i] - Paeth(a, b, c); break;
+			default:					out[i] = row[i]; break;
+			}
+		}
+	}
+
+	static void FilterAdaptive(const uint8_t* row, const uint8_t* prev, uint32_t rowSize, uint32_t bpp, uint8_t* dest, uint8_t* scratch)
+	{
+		uint64_t bestSum = UINT64_MAX;
+		for (uint32_t f = (uint32_t)PngFilter::None; f <= (uint32_t)PngFilter::Paeth; f++)
+		{
+			FilterRow((PngFilter)f, row, prev, rowSize, bpp, scratch);
+
+			uint64_t sum = 0;
+			for (uint32_t i = 1; i <= rowSize; i++)
+				sum += std::abs((int8_t)scratch[i]);
+			if (sum < bestSum)
+			{
+				bestSum = sum;
+				memcpy(dest, scratch, rowSize + 1);
+			}
+		}
+	}
+
+	static void WriteUInt32(std::vector<uint8_t>& out, uint32_t v)
+	{
+		out.push_back(v >> 24); out.push_back((v >> 16) & 0xFF); out.push_back((v >> 8) & 0xFF); out.push_back(v & 0xFF);
+	}
+
+	static void WriteChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, uint32_t size)
+	{
+		WriteUInt32(out, size);
+		size_t typeStart = out.size();
+		out.insert(out.end(), type, type + 4);
+		if (size)
+			out.insert(out.end(), data, data + size);
+
+		uLong crc = crc32(0L, Z_NULL, 0);
+		crc = crc32(crc, out.data() + typeStart, size + 4);
+		WriteUInt32(out, crc);
+	}
+
+	PngEncoder::PngEncoder(uint32_t nThreads)
+	{
+		this->nThreads = nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void PngEncoder::setCompressionLevel(int level)
+	{
+		this->level = std::min(std::max(level, 0), 9);
+	}
+
+	void PngEncoder::setStrategy(int strategy)
+	{
+		this->strategy = strategy;
+	}
+
+	void PngEncoder::setFilter(PngFilter filter)
+	{
+		this->filter = filter;
+	}
+
+	void PngEncoder::setBandSize(uint32_t bytes)
+	{
+		this->bandSize = bytes;
+	}
+
+	bool PngEncoder::encode(const uint8_t* img, int width, int height, int components, std::vector<uint8_t>& out) const
+	{
+		if (width <= 0 || height <= 0 || components < 1 || components > 4)
+			return false;
+
+		uint32_t rowSize = width * components;
+		uint32_t filteredRowSize = rowSize + 1;
+		// Bands only depend on the band size, so the output is the same with any number of threads
+		uint32_t bandRows = std::max<uint32_t>(1, bandSize / filteredRowSize);
+		uint32_t nBands = (height + bandRows - 1) / bandRows;
+
+		std::vector<uint8_t> filtered((size_t)filteredRowSize * height);
+		std::vector<std::vector<uint8_t>> compressed(nBands);
+		std::vector<uLong> checksums(nBands);
+		std::vector<char> results(nBands, 0);
+
+		auto runBands = [&](auto work) {
+			std::vector<std::thread> threads;
+			for (uint32_t t = 0; t < std::min(nThreads, nBands); t++)
+				threads.emplace_back([&, t]() {
+					for (uint32_t b = t; b < nBands; b += nThreads)
+						work(b);
+				});
+			for (auto& thread : threads)
+				thread.join();
+		};
+
+		// Filtering only depends on the unfiltered previous row, but deflating a band needs the filtered end of the previous one
+		runBands([&](uint32_t b) {
+			std::vector<uint8_t> scratch(filteredRowSize);
+			uint32_t end = std::min<uint32_t>((b + 1) * bandRows, height);
+			for (uint32_t y = b * bandRows; y < end; y++)
+			{
+				const uint8_t* row = img + (size_t)y * rowSize;
+				const uint8_t* prev = y > 0 ? row - rowSize : nullptr;
+				uint8_t* dest = filtered.data() + (size_t)y * filteredRowSize;
+
+				if (filter == PngFilter::Adaptive)
+					FilterAdaptive(row, prev, rowSize, components, dest, scratch.data());
+				else
+					FilterRow(filter, row, prev, rowSize, components, dest);
+			}
+		});
+
+		runBands([&](uint32_t b) {
+			size_t start = (size_t)b * bandRows * filteredRowSize;
+			size_t end = std::min<size_t>((size_t)(b + 1) * bandRows, height) * filteredRowSize;
+			bool last = b == nBands - 1;
+
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+			if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) != Z_OK)
+				return;
+
+			if (b > 0)
+			{
+				size_t dictSize = std::min<size_t>(WindowSize, start);
+				deflateSetDictionary(&stream, filtered.data() + start - dictSize, dictSize);
+			}
+
+			std::vector<uint8_t>& dest = compressed[b];
+			dest.resize(deflateBound(&stream, end - start) + 16);
+			stream.next_in = filtered.data() + start;
+			stream.avail_in = end - start;
+			stream.next_out = dest.data();
+			stream.avail_out = dest.size();
+
+			int ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+			results[b] = (last ? ret == Z_STREAM_END : ret == Z_OK && stream.avail_out > 0) && stream.avail_in == 0;
+			dest.resize(stream.total_out);
+			deflateEnd(&stream);
+
+			checksums[b] = adler32(adler32(0L, Z_NULL, 0), filtered.data() + start, end - start);
+		});
+
+		if (std::find(results.begin(), results.end(), 0) != results.end())
+			return false;
+
+		// zlib header, CINFO = 7 (32KB window) and FLEVEL from the compression level, FCHECK makes it a multiple of 31
+		uint8_t cmf = 0x78;
+		uint8_t flg = (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+		flg += (31 - ((cmf << 8) | flg) % 31) % 31;
+
+		uLong adler = checksums[0];
+		for (uint32_t b = 1; b < nBands; b++)
+		{
+			size_t length = (std::min<size_t>((size_t)(b + 1) * bandRows, height) - (size_t)b * bandRows) * filteredRowSize;
+			adler = adler32_combine(adler, checksums[b], length);
+		}
+
+		out.clear();
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), signature, signature + 8);
+
+		const uint8_t colorTypes[4] = { 0, 4, 2, 6 };
+		uint8_t ihdr[13] = {
+			(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+			(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+			8, colorTypes[components - 1], 0, 0, 0
+		};
+		WriteChunk(out, "IHDR", ihdr, 13);
+
+		// One IDAT per band, the first starts with the zlib header and the last ends with the checksum
+		for (uint32_t b = 0; b < nBands; b++)
+		{
+			std::vector<uint8_t>& data = compressed[b];
+			if (b == 0)
+				data.insert(data.begin(), { cmf, flg });
+			if (b == nBands - 1)
+				data.insert(data.end(), { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler });
+			WriteChunk(out, "IDAT", data.data(), data.size());
+		}
+		WriteChunk(out, "IEND", nullptr, 0);
+
+		return true;
+	}
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef DSTREAM_ENABLE_ZIP
+
+#include <cstdint>
+#include <vector>
+
+#include <zlib.h>
+
+namespace DStream
+{
+	// Adaptive picks, for each row, the filter with the smallest sum of absolute values, like libpng does
+	enum class PngFilter { None = 0, Sub, Up, Average, Paeth, Adaptive };
+
+	// PNG writer that filters and deflates bands of rows on different threads, pigz style: every band is a raw
+	// deflate stream ending with a sync flush (the last one with a final block), primed with the last 32KB of the
+	// previous band, so the concatenation is a single zlib stream.
+	class PngEncoder
+	{
+	public:
+		// 0 threads uses one per core
+		PngEncoder(uint32_t nThreads = 0);
+
+		// zlib level, 0-9
+		void setCompressionLevel(int level);
+		// Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE or Z_FIXED
+		void setStrategy(int strategy);
+		void setFilter(PngFilter filter);
+		// Amount of filtered data per band, smaller bands keep more threads busy on small images but restart
+		// the deflate stream more often
+		void setBandSize(uint32_t bytes);
+
+		bool encode(const uint8_t* img, int width, int height, int components, std::vector<uint8_t>& out) const;
+
+	private:
+		uint32_t nThreads;
+		int level = 6;
+		int strategy = Z_DEFAULT_STRATEGY;
+		PngFilter filter = PngFilter::Adaptive;
+		uint32_t bandSize = 1 << 18;
+	};
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <RateControl.h>
+#include <ImageReader.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace DStream
+{
+	RateControl::RateControl(RateFormat format) : format(format)
+	{
+		encoder.setJpegColorSpace(JCS_RGB);
+		decoder.setJpegColorSpace(JCS_RGB);
+	}
+
+	void RateControl::setQualityRange(int minQuality, int maxQuality)
+	{
+		this->minQuality = std::clamp(minQuality, 1, 100);
+		this->maxQuality = std::clamp(maxQuality, this->minQuality, 100);
+	}
+
+	void RateControl::setEstimateStep(int step)
+	{
+		estimateStep = step;
+	}
+
+#ifdef DSTREAM_ENABLE_WEBP
+	void RateControl::setWebpSettings(const WebpSettings& settings)
+	{
+		webpSettings = settings;
+		webpSettings.Lossless = false;
+	}
+#endif
+
+	bool RateControl::encode(uint8_t* img, int width, int height, int quality, std::vector<uint8_t>& out)
+	{
+#ifdef DSTREAM_ENABLE_WEBP
+		if (format == RateFormat::WEBP)
+		{
+			webpSettings.Quality = quality;
+			return ImageWriter::EncodeWEBP(img, width, height, webpSettings, out);
+		}
+#endif
+		uint8_t* jpeg = nullptr;
+		int length = 0;
+		encoder.setQuality(quality);
+		if (!encoder.encode(img, width, height, jpeg, length))
+			return false;
+
+		out.assign(jpeg, jpeg + length);
+		free(jpeg);
+		return true;
+	}
+
+	bool RateControl::decode(const std::vector<uint8_t>& data, int width, int height, uint8_t* dest)
+	{
+#ifdef DSTREAM_ENABLE_WEBP
+		if (format == RateFormat::WEBP)
+			return ImageReader::DecodeWEBP(data.data(), data.size(), dest, width * height * 3, webpSettings.YuvPassthrough);
+#endif
+		// The frame was encoded at width x height, any other size means the data is broken
+		int w, h;
+		return decoder.decodeNonAlloc(data.data(), data.size(), dest, w, h) && w == width && h == height;
+	}
+
+	// Encoded size grows with the number of pixels, so a frame keeping every step-th pixel of every step-th row
+	// is roughly step^2 times smaller at the same quality
+	int RateControl::estimateQuality(uint8_t* img, int width, int height, size_t maxBytes)
+	{
+		int sampleWidth = width / estimateStep, sampleHeight = height / estimateStep;
+		if (sampleWidth < 16 || sampleHeight < 16)
+			return (minQuality + maxQuality) / 2;
+
+		std::vector<uint8_t> sample((size_t)sampleWidth * sampleHeight * 3);
+		for (int y = 0; y < sampleHeight; y++)
+			for (int x = 0; x < sampleWidth; x++)
+				for (int c = 0; c < 3; c++)
+					sample[((size_t)y * sampleWidth + x) * 3 + c] = img[((size_t)y * estimateStep * width + x * estimateStep) * 3 + c];
+
+		size_t sampleBudget = maxBytes / (estimateStep * estimateStep);
+		int lo = minQuality, hi = maxQuality, ret = minQuality;
+		while (lo <= hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (encode(sample.data(), sampleWidth, sampleHeight, mid, candidate) && candidate.size() <= sampleBudget)
+			{
+				ret = mid;
+				lo = mid + 1;
+			}
+			else
+				hi = mid - 1;
+		}
+		return ret;
+	}
+
+	bool RateControl::fitSize(uint8_t* img, int width, int height, size_t maxBytes, std::vector<uint8_t>& out)
+	{
+		nEncodes = 0;
+		maxError = 0;
+		estimatedQuality = estimateStep > 1 ? estimateQuality(img, width, height, maxBytes) : (minQuality + maxQuality) / 2;
+
+		int best = -1, lo = minQuality, hi = maxQuality;
+		auto fits = [&](int q) {
+			nEncodes++;
+			if (!encode(img, width, height, q, candidate) || candidate.size() > maxBytes)
+				return false;
+			best = q;
+			out.swap(candidate);
+			return true;
+		};
+
+		// Bracket the answer with steps that double away from the guess, then bisect the bracket
+		int guess = estimatedQuality;
+		if (fits(guess))
+		{
+			lo = guess + 1;
+			for (int step = 2; lo <= hi; step *= 2)
+			{
+				int q = std::min(hi, guess + step);
+				if (!fits(q))
+				{
+					hi = q - 1;
+					break;
+				}
+				lo = q + 1;
+			}
+		}
+		else
+		{
+			hi = guess - 1;
+			for (int step = 2; lo <= hi; step *= 2)
+			{
+				int q = std::max(lo, guess - step);
+				if (fits(q))
+				{
+					lo = q + 1;
+					break;
+				}
+				hi = q - 1;
+			}
+		}
+
+		while (lo <= hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (fits(mid))
+				lo = mid + 1;
+			else
+				hi = mid - 1;
+		}
+
+		// Nothing fits: the last encode was at the minimum quality
+		if (best < 0)
+		{
+			quality = minQuality;
+			out.swap(candidate);
+			return false;
+		}
+		quality = best;
+		return true;
+	}
+
+	bool RateControl::fitError(uint8_t* img, int width, int height, const uint16_t* depth, uint32_t maxError, const DecodeFunction& decodeDepth,
+		std::vector<uint8_t>& out)
+	{
+		uint32_t nElements = width * height;
+		colors.resize((size_t)nElements * 3);
+		decoded.resize(nElements);
+		nEncodes = 0;
+		estimatedQuality = 0;
+
+		// Error doesn't strictly decrease with quality, bisecting finds a quality that meets the target and is lower
+		// than any failing one it has seen
+		int best = -1, lo = minQuality, hi = maxQuality;
+		uint32_t bestError = 0, error = 0;
+		while (lo <= hi)
+		{
+			int mid = (lo + hi) / 2;
+			nEncodes++;
+			error = UINT32_MAX;
+			if (encode(img, width, height, mid, candidate) && decode(candidate, width, height, colors.data()))
+			{
+				decodeDepth(colors.data(), decoded.data(), nElements);
+				error = 0;
+				for (uint32_t i = 0; i < nElements; i++)
+					error = std::max<uint32_t>(error, std::abs((int)decoded[i] - (int)depth[i]));
+			}
+
+			if (error <= maxError)
+			{
+				best = mid;
+				bestError = error;
+				out.swap(candidate);
+				hi = mid - 1;
+			}
+			else
+				lo = mid + 1;
+		}
+
+		// Nothing meets the target: the last encode was at the maximum quality
+		if (best < 0)
+		{
+			quality = maxQuality;
+			this->maxError = error;
+			out.swap(candidate);
+			return false;
+		}
+		quality = best;
+		this->maxError = bestError;
+		return true;
+	}
+}
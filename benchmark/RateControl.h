@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <JpegEncoder.h>
+#include <JpegDecoder.h>
+#include <ImageWriter.h>
+
+namespace DStream
+{
+	enum class RateFormat { JPG = 0, WEBP };
+
+	// Picks the quality of every frame in memory, either the highest one that fits a byte budget or the lowest one
+	// that keeps the decoded depth within a maximum error. Quality is searched by bracketing around a first guess
+	// and bisecting the bracket, the encoder and decoder are kept for the whole search. The first guess for a byte
+	// budget can come from a frame subsampled by estimateStep, which is a lot cheaper to encode than the full one.
+	class RateControl
+	{
+	public:
+		// Turns the decoded colours of a frame back to depth, the way the receiver would
+		typedef std::function<void(const uint8_t* colors, uint16_t* depth, uint32_t nElements)> DecodeFunction;
+
+		RateControl(RateFormat format = RateFormat::JPG);
+
+		RateControl(const RateControl&) = delete;
+		void operator=(const RateControl&) = delete;
+
+		void setQualityRange(int minQuality, int maxQuality);
+		// 0 or 1 disables the estimate
+		void setEstimateStep(int step);
+		// Colour spaces and subsampling of the JPEG encoder and decoder used in the search, RGB 4:4:4 by default
+		JpegEncoder& jpegEncoder() { return encoder; }
+		JpegDecoder& jpegDecoder() { return decoder; }
+#ifdef DSTREAM_ENABLE_WEBP
+		// Quality is set by the search, Lossless is ignored
+		void setWebpSettings(const WebpSettings& settings);
+#endif
+
+		// Returns false if the frame doesn't fit even at the minimum quality, out is then encoded at that quality
+		bool fitSize(uint8_t* img, int width, int height, size_t maxBytes, std::vector<uint8_t>& out);
+		// Returns false if the error is above maxError even at the maximum quality, out is then encoded at that quality
+		bool fitError(uint8_t* img, int width, int height, const uint16_t* depth, uint32_t maxError, const DecodeFunction& decode,
+			std::vector<uint8_t>& out);
+
+		// Results of the last search. Encodes only counts the full frame ones
+		int getQuality() const { return quality; }
+		int getEncodes() const { return nEncodes; }
+		int getEstimatedQuality() const { return estimatedQuality; }
+		uint32_t getMaxError() const { return maxError; }
+
+	private:
+		bool encode(uint8_t* img, int width, int height, int quality, std::vector<uint8_t>& out);
+		bool decode(const std::vector<uint8_t>& data, int width, int height, uint8_t* dest);
+		int estimateQuality(uint8_t* img, int width, int height, size_t maxBytes);
+
+		RateFormat format;
+		JpegEncoder encoder;
+		JpegDecoder decoder;
+#ifdef DSTREAM_ENABLE_WEBP
+		WebpSettings webpSettings = WebpSettings::LibwebpDefault(75);
+#endif
+
+		int minQuality = 1;
+		int maxQuality = 100;
+		int estimateStep = 4;
+
+		std::vector<uint8_t> candidate;
+		std::vector<uint8_t> colors;
+		std::vector<uint16_t> decoded;
+
+		int quality = 0;
+		int nEncodes = 0;
+		int estimatedQuality = 0;
+		uint32_t maxError = 0;
+	};
+}
@@ -6,11 +6,23 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include <DepthmapReader.h>
 #include <DepthProcessing.h>
 #include <ImageReader.h>
 #include <ImageWriter.h>
+#include <JpegDecoder.h>
+#include <ParallelJpegDecoder.h>
+#include <LumaLayout.h>
+#include <RateControl.h>
+#include <Autotuner.h>
+#include <TileHeader.h>
+#include <DepthMask.h>
+#include <QuantTables.h>
 
 #include <StreamCoder.h>
 #include <Implementations/Hilbert.h>
@@ -37,27 +49,63 @@ int getopt(int nargc, char* const nargv[], const char* ostr);
 StreamCoder<Hilbert> hilbertCoder;
 StreamCoder<Packed3> packedCoder;
 StreamCoder<Split3> splitCoder;
+StreamCoder<Packed2> packed2Coder;
+StreamCoder<Split2> split2Coder;
 StreamCoder<Triangle> triangleCoder;
 StreamCoder<Phase> phaseCoder;
 StreamCoder<Hue> hueCoder;
 StreamCoder<Morton> mortonCoder;
 
+// Window to decode, the whole image if Width is 0
+struct Region
+{
+    int X = 0, Y = 0, Width = 0, Height = 0;
+};
+
+// Side of the tiles tuned by AUTO when the depth isn't quantized in tiles
+const uint32_t AutoTileSize = 256;
+
 void Usage()
 {
     std::cerr <<
         R"use(Usage: dstream-cmd [OPTIONS] <DIRECTORY>
 
-    DIRECTORY is the path to the folder containing the depth data
+    DIRECTORY is the path to the folder containing the depth data. No-data values (nodata_value of .asc files) are filled before
+    coding and their mask is saved in a .mask file next to the encoded one. Valid values are then quantized to [1, 65535], and when
+    decoding no-data values are set to 0
       -d <output>: output folder in which final data will be saved
-      -f <format>: file format to which data will be encoded or from which it will be decoded. Choose one between JPG, PNG, WEBP, LOSSY_WEBP, SPLIT_WEBP, defaults to WEBP. 
+      -f <format>: file format to which data will be encoded or from which it will be decoded. Choose one between JPG, PNG, DSQ, DSD, WEBP, LOSSY_WEBP, SPLIT_WEBP, defaults to WEBP. 
+                    DSD stores the 16 bit depth directly, without a coding algorithm. 
                     When decoding, the format is deduced from the file extension. Specify the format if you only want to decode a given format
+                    JPG uses quantization tables fitted to the algorithm, with finer steps on the channels that move depth the most,
+                    except with AUTO and -l
       -r <recursive>: navigate the input directory recursively and process all the files contained in it
-      -a <algorithm>: algorithm to be used (algorithm names: PACKED, TRIANGLE, MORTON, HILBERT, PHASE, SPLIT, HUE)
+      -a <algorithm>: algorithm to be used (algorithm names: PACKED, PACKED2, TRIANGLE, MORTON, HILBERT, PHASE, SPLIT, SPLIT2, HUE, AUTO)
+                    AUTO only applies to JPG, without -l. It picks the algorithm and bits of every tile (-g tiles, 256 x 256 without -g)
+                    by trial encoding a subsample at the given quality, and saves the choices and the depth ranges in a .tile file
+                    next to the encoded one. When decoding, AUTO reads the .tile files
       -q <quantization>: quantization level
       -n <no quantize>: don't quantize raw height data between 0 and 65535. This is normally done prior to quantizing to the specified quantization level.
       -b <bits>: number of bits dedicated to the algorithm (only used by Hilbert and Packed). The remaining ones will be used to enlarge / shrink data
       -e <no enlarge>: don't use the whole 8 bit range of colours if encoded colours end up using less
       -j <quality>: quality to use if encoding, only applies to WEBP and PNG
+      -x <max error>: maximum error allowed when encoding to DSD, 0 (default) is lossless
+      -t <target>: only applies to JPG and LOSSY_WEBP, replaces -j. A number of bytes picks the highest quality whose file fits in it,
+                    E<max error> (e.g. E64) picks the lowest quality whose decoded depth is within that error
+      -l <luma layout>: only applies to JPG and LOSSY_WEBP. Stores the most significant channel of the algorithm as luma and the others
+                    as 4:2:0 subsampled chroma, without colour conversion. Must be specified when decoding as well. LOSSY_WEBP
+                    uses the libwebp default settings, with -l noise shaping and the loop filter are off
+      -g <tile size>: quantizes every tile size x tile size tile of the depth map to its own range, so that tiles spanning
+                    a small part of the depth range of the whole map still use every level. The ranges are saved in a .ranges file
+                    next to the encoded one. When decoding, .ranges files are read and the decoded depth is saved instead of the
+                    quantized values. Frames quantized in tiles can't be decoded as regions or previews
+      -s <scale>: only applies to JPG when decoding. Decodes a 1/scale size preview (2, 4 or 8) straight from the DCT coefficients,
+                    without decoding the full resolution image
+      --parallel: only applies to JPG when encoding, without -l. Encodes strips of the image on every core, with a restart marker
+                    every MCU row and the standard Huffman tables, so that the file can be decoded in bands on every core too.
+                    Files are larger than the default ones, which use optimized Huffman tables
+      --roi <x,y,w,h>: when decoding, only decodes the w x h window at (x, y). JPEGs only decode the rows above and in the
+                    window, with libjpeg-turbo only the columns covering it as well
       -m <mode>: program mode, E for encoding, D for decoding
       -p <print>: print the decoded texture in PNG format, 8 bit grayscale
       -?: display this message
@@ -67,15 +115,43 @@ void Usage()
 }
 
 int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir, std::string& algo, uint8_t& jpeg, 
-    uint8_t& algoBits,  bool& recursive, std::string& mode, std::string& outputFormat, bool& enlarge, bool& quantize, bool& printTexture)
+    uint8_t& algoBits,  bool& recursive, std::string& mode, std::string& outputFormat, bool& enlarge, bool& quantize, bool& printTexture,
+    uint16_t& maxError, bool& lumaLayout, size_t& targetSize, int& targetError, int& previewScale, Region& roi, bool& parallelJpeg,
+    uint32_t& tileSize)
 {
     int c;
+
+    // getopt only handles single letter options, --parallel and --roi are taken out beforehand
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--parallel") == 0)
+        {
+            parallelJpeg = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--roi") != 0)
+        {
+            args.push_back(argv[i]);
+            continue;
+        }
+
+        if (i + 1 >= argc || sscanf(argv[++i], "%d,%d,%d,%d", &roi.X, &roi.Y, &roi.Width, &roi.Height) != 4 ||
+            roi.X < 0 || roi.Y < 0 || roi.Width <= 0 || roi.Height <= 0)
+        {
+            std::cerr << "The region of interest should be x,y,width,height" << std::endl;
+            return -3;
+        }
+    }
+    argc = (int)args.size();
+    argv = args.data();
+
     recursive = false;
     enlarge = true;
     quantize = true;
 
 
-    while ((c = getopt(argc, argv, "d:a:q:j:b:m:f:rpenh::")) != -1) {
+    while ((c = getopt(argc, argv, "d:a:q:j:b:m:f:x:t:s:g:rpenlh::")) != -1) {
         switch (c) {
         case 'd':
         {
@@ -87,7 +163,8 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
         case 'a':
         {
             std::string arg(optarg);
-            if (arg == "PACKED" || arg == "TRIANGLE" || arg == "MORTON" || arg == "HILBERT" || arg == "PHASE" || arg == "SPLIT")
+            if (arg == "PACKED" || arg == "TRIANGLE" || arg == "MORTON" || arg == "HILBERT" || arg == "PHASE" || arg == "SPLIT" ||
+                arg == "PACKED2" || arg == "SPLIT2" || arg == "AUTO")
             {
                 algo = optarg;
                 break;
@@ -111,6 +188,55 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
             }
             break;
         }
+        case 'x':
+        {
+            int x = atoi(optarg);
+            if (x >= 0 && x <= 65535)
+                maxError = x;
+            else
+            {
+                std::cerr << "Maximum error should be in the range of [0, 65535]" << std::endl;
+                return -3;
+            }
+            break;
+        }
+        case 't':
+        {
+            std::string arg(optarg);
+            if ((arg[0] == 'E' || arg[0] == 'e') && arg.length() > 1 && atoi(arg.c_str() + 1) >= 0)
+                targetError = atoi(arg.c_str() + 1);
+            else if (atoll(optarg) > 0)
+                targetSize = atoll(optarg);
+            else
+            {
+                std::cerr << "Target should be a positive number of bytes or E followed by the maximum error" << std::endl;
+                return -3;
+            }
+            break;
+        }
+        case 'g':
+        {
+            int g = atoi(optarg);
+            if (g <= 0)
+            {
+                std::cerr << "The tile size should be a positive number of values" << std::endl;
+                return -3;
+            }
+            tileSize = g;
+            break;
+        }
+        case 's':
+        {
+            int s = atoi(optarg);
+            if (s == 1 || s == 2 || s == 4 || s == 8)
+                previewScale = s;
+            else
+            {
+                std::cerr << "Preview scale should be 1, 2, 4 or 8" << std::endl;
+                return -3;
+            }
+            break;
+        }
         case 'b':
         {
             int b = atoi(optarg);
@@ -128,7 +254,7 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
         case 'f':
         {
             outputFormat = optarg;
-            if (outputFormat != "PNG" && outputFormat != "JPG" 
+            if (outputFormat != "PNG" && outputFormat != "JPG" && outputFormat != "DSQ" && outputFormat != "DSD"
 #ifdef DSTREAM_ENABLE_WEBP
                 && outputFormat != "WEBP" && 
                 outputFormat != "LOSSY_WEBP" && outputFormat != "SPLIT_WEBP"
@@ -162,6 +288,9 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
         case 'r':
             recursive = true;
             break;
+        case 'l':
+            lumaLayout = true;
+            break;
         case 'h':
         case '?': Usage(); return -5;
         default:
@@ -170,6 +299,12 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
             return -6;
         }
     }
+    if (roi.Width > 0 && previewScale > 1)
+    {
+        std::cerr << "A region of interest can't be decoded as a preview" << std::endl;
+        return -3;
+    }
+
     if (optind == argc) {
         std::cerr << "Missing input folder path" << std::endl;
         Usage();
@@ -195,7 +330,8 @@ int ParseOptions(int argc, char** argv, std::string& inDir, std::string& outDir,
     return 0;
 }
 
-int ValidateInput(const std::string& algorithm, uint8_t jpeg, uint8_t algoBits, const std::string& mode, const std::string& format)
+int ValidateInput(const std::string& algorithm, uint8_t jpeg, uint8_t algoBits, const std::string& mode, const std::string& format,
+    bool lumaLayout)
 {
     if (algorithm == "")
     {
@@ -209,9 +345,16 @@ int ValidateInput(const std::string& algorithm, uint8_t jpeg, uint8_t algoBits,
         return -1;
     }
 
+    // The autotuner scores its candidates through RGB JPEGs
+    if (algorithm == "AUTO" && (format != "JPG" || lumaLayout))
+    {
+        std::cerr << "AUTO only applies to JPG, without luma layout." << std::endl;
+        return -1;
+    }
+
     if (mode == "D" && jpeg <= 100)
         std::cout << "Image quality specified, but DECODING mode is set. The quality parameter will be ignored." << std::endl;
-    if (jpeg <= 100 && (format == "WEBP" || format == "PNG"))
+    if (jpeg <= 100 && (format == "WEBP" || format == "PNG" || format == "DSQ" || format == "DSD"))
         std::cout << "Image quality specified, but selected format is lossless. The quality parameter will be ignored." << std::endl;
 
     if (algorithm == "Hilbert")
@@ -231,6 +374,8 @@ int ValidateInput(const std::string& algorithm, uint8_t jpeg, uint8_t algoBits,
 void Encode(uint16_t* input, Color* output, uint32_t nElements, const std::string& coder)
 {
     if (coder == "PACKED") packedCoder.Encode((Color*)output, input, nElements);
+    else if (coder == "PACKED2") packed2Coder.Encode((Color*)output, input, nElements);
+    else if (coder == "SPLIT2") split2Coder.Encode((Color*)output, input, nElements);
     else if (coder == "HUE") hueCoder.Encode((Color*)output, input, nElements);
     else if (coder == "HILBERT") hilbertCoder.Encode((Color*)output, input, nElements);
     else if (coder == "MORTON") mortonCoder.Encode((Color*)output, input, nElements);
@@ -242,6 +387,8 @@ void Encode(uint16_t* input, Color* output, uint32_t nElements, const std::strin
 void Decode(uint8_t* input, uint16_t* output, uint32_t nElements, const std::string& coder)
 {
     if (coder == "PACKED") packedCoder.Decode(output, (Color*)input, nElements);
+    else if (coder == "PACKED2") packed2Coder.Decode(output, (Color*)input, nElements);
+    else if (coder == "SPLIT2") split2Coder.Decode(output, (Color*)input, nElements);
     else if (coder == "HUE") hueCoder.Decode(output, (Color*)input, nElements);
     else if (coder == "HILBERT") hilbertCoder.Decode(output, (Color*)input, nElements);
     else if (coder == "MORTON") mortonCoder.Decode(output, (Color*)input, nElements);
@@ -250,6 +397,128 @@ void Decode(uint8_t* input, uint16_t* output, uint32_t nElements, const std::str
     else triangleCoder.Decode(output, (Color*)input, nElements);
 }
 
+// Decodes rows of a frame quantized in tiles straight to depth, input and output point to the first row
+void DecodeToDepth(uint8_t* input, float* output, uint32_t width, uint32_t firstRow, uint32_t nRows, const TileRanges& ranges,
+    const uint8_t* mask, const std::string& coder)
+{
+    if (coder == "PACKED") packedCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "PACKED2") packed2Coder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "SPLIT2") split2Coder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "HUE") hueCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "HILBERT") hilbertCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "MORTON") mortonCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "SPLIT") splitCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else if (coder == "PHASE") phaseCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+    else triangleCoder.DecodeToDepth(output, (Color*)input, width, firstRow, nRows, ranges, mask);
+}
+
+uint8_t GetCoarseChannel(const std::string& coder)
+{
+    if (coder == "PACKED") return packedCoder.GetCoarseChannel();
+    else if (coder == "PACKED2") return packed2Coder.GetCoarseChannel();
+    else if (coder == "SPLIT2") return split2Coder.GetCoarseChannel();
+    else if (coder == "HUE") return hueCoder.GetCoarseChannel();
+    else if (coder == "HILBERT") return hilbertCoder.GetCoarseChannel();
+    else if (coder == "MORTON") return mortonCoder.GetCoarseChannel();
+    else if (coder == "SPLIT") return splitCoder.GetCoarseChannel();
+    else if (coder == "PHASE") return phaseCoder.GetCoarseChannel();
+    else return triangleCoder.GetCoarseChannel();
+}
+
+// JPEG quantization tables fitted to the colours the coder encoded a frame to
+std::vector<std::array<unsigned int, 64>> GetQuantTables(const Color* colors, uint32_t nElements, const std::string& coder)
+{
+    if (coder == "PACKED") return QuantTables::Derive(packedCoder, colors, nElements);
+    else if (coder == "PACKED2") return QuantTables::Derive(packed2Coder, colors, nElements);
+    else if (coder == "SPLIT2") return QuantTables::Derive(split2Coder, colors, nElements);
+    else if (coder == "HUE") return QuantTables::Derive(hueCoder, colors, nElements);
+    else if (coder == "HILBERT") return QuantTables::Derive(hilbertCoder, colors, nElements);
+    else if (coder == "MORTON") return QuantTables::Derive(mortonCoder, colors, nElements);
+    else if (coder == "SPLIT") return QuantTables::Derive(splitCoder, colors, nElements);
+    else if (coder == "PHASE") return QuantTables::Derive(phaseCoder, colors, nElements);
+    else return QuantTables::Derive(triangleCoder, colors, nElements);
+}
+
+// Searches the quality that meets the target and writes the result
+void WriteRateControlled(const std::string& path, uint8_t* encoded, const uint16_t* depth, uint32_t width, uint32_t height,
+    const std::string& format, const std::string& algorithm, TiledCoder* tiledCoder, bool lumaLayout, size_t targetSize, int targetError,
+    const std::vector<std::array<unsigned int, 64>>& quantTables)
+{
+    RateControl rateControl(format == "JPG" ? RateFormat::JPG : RateFormat::WEBP);
+    rateControl.jpegEncoder().setQuantTables(quantTables);
+    uint8_t coarseChannel = GetCoarseChannel(algorithm);
+    if (lumaLayout)
+    {
+        rateControl.jpegEncoder().setColorSpace(J_COLOR_SPACE::JCS_YCbCr, 3);
+        rateControl.jpegEncoder().setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+        rateControl.jpegEncoder().setChromaSubsampling(true);
+        rateControl.jpegDecoder().setColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+        rateControl.jpegDecoder().setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+        rateControl.jpegDecoder().setFancyUpsampling(false);
+    }
+#ifdef DSTREAM_ENABLE_WEBP
+    rateControl.setWebpSettings(lumaLayout ? WebpSettings::LumaPriority(75) : WebpSettings::LibwebpDefault(75));
+#endif
+
+    std::vector<uint8_t> data;
+    bool met;
+    if (targetError >= 0)
+    {
+        std::vector<Color> colors(width * height);
+        auto decode = [&](const uint8_t* decodedColors, uint16_t* decodedDepth, uint32_t nElements) {
+            if (lumaLayout)
+                LumaLayout::Revert(colors.data(), (const Color*)decodedColors, nElements, coarseChannel);
+            else
+                memcpy(colors.data(), decodedColors, nElements * 3);
+
+            if (tiledCoder)
+                tiledCoder->decode(decodedDepth, colors.data(), 0, 0, width, height);
+            else
+                Decode((uint8_t*)colors.data(), decodedDepth, nElements, algorithm);
+        };
+        met = rateControl.fitError(encoded, width, height, depth, targetError, decode, data);
+    }
+    else
+        met = rateControl.fitSize(encoded, width, height, targetSize, data);
+
+    std::cout << path << ": quality " << rateControl.getQuality() << ", " << data.size() << " bytes, " << rateControl.getEncodes() << " encodes";
+    if (!met)
+        std::cout << " (target not met)";
+    std::cout << std::endl;
+
+    std::ofstream outFile(path, std::ios::out | std::ios::binary);
+    outFile.write((const char*)data.data(), data.size());
+}
+
+void SetupCoder(const std::string& algorithm, bool enlarge, bool interpolate, uint8_t algoBits)
+{
+    if (algorithm == "HILBERT") hilbertCoder = StreamCoder<Hilbert>     (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "PACKED") packedCoder = StreamCoder<Packed3>       (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "PACKED2") packed2Coder = StreamCoder<Packed2>     (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "SPLIT") splitCoder = StreamCoder<Split3>          (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "SPLIT2") split2Coder = StreamCoder<Split2>        (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "TRIANGLE") triangleCoder = StreamCoder<Triangle>  (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "PHASE") phaseCoder = StreamCoder<Phase>           (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "HUE") hueCoder = StreamCoder<Hue>                 (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+    if (algorithm == "MORTON") mortonCoder = StreamCoder<Morton>        (enlarge, interpolate, algoBits, { 8,8,8 }, true);
+}
+
+std::string GetAlgorithmName(CoderType coder)
+{
+    switch (coder)
+    {
+    case CoderType::Packed2: return "PACKED2";
+    case CoderType::Packed3: return "PACKED";
+    case CoderType::Split2: return "SPLIT2";
+    case CoderType::Split3: return "SPLIT";
+    case CoderType::Hilbert: return "HILBERT";
+    case CoderType::Morton: return "MORTON";
+    case CoderType::Hue: return "HUE";
+    case CoderType::Phase: return "PHASE";
+    default: return "TRIANGLE";
+    }
+}
+
 std::vector<std::filesystem::path> GetFiles(const std::filesystem::path& path, bool recursive, const std::string inputPrefix, const std::string outDir, char codingMode)
 {
     std::vector<std::filesystem::path> ret;
@@ -275,7 +544,7 @@ std::vector<std::filesystem::path> GetFiles(const std::filesystem::path& path, b
 #endif
                 )
                 ret.push_back(file);
-            else if ((codingMode == 'D') && (ext == ".png" || ext == ".jpg" || ext == ".jpeg"
+            else if ((codingMode == 'D') && (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".dsq" || ext == ".dsd"
 #ifdef DSTREAM_ENABLE_WEBP
                 || ext == ".webp" || ext == ".splitwebp")
 #endif
@@ -309,13 +578,20 @@ std::vector<std::filesystem::path> GetFiles(const std::filesystem::path& path, b
 int main(int argc, char** argv)
 {
     std::unordered_map<std::string, std::string> inPath2OutPath;
-    bool saveDecoded = true, recursive = false, enlarge = true, quantize;
+    bool saveDecoded = true, recursive = false, enlarge = true, quantize, lumaLayout = false;
     uint8_t jpeg = 100, algoBits = 8;
+    uint16_t maxError = 0;
+    size_t targetSize = 0;
+    int targetError = -1;
+    int previewScale = 1;
+    Region roi;
+    bool parallelJpeg = false;
+    uint32_t tileSize = 0;
     std::string inDir, outDir = "", algorithm = "-", mode = "-", outputFormat = "JPG";
 
-    if (ParseOptions(argc, argv, inDir, outDir, algorithm, jpeg, algoBits, recursive, mode, outputFormat, enlarge, quantize, saveDecoded) != 0)
+    if (ParseOptions(argc, argv, inDir, outDir, algorithm, jpeg, algoBits, recursive, mode, outputFormat, enlarge, quantize, saveDecoded, maxError, lumaLayout, targetSize, targetError, previewScale, roi, parallelJpeg, tileSize) != 0)
         return -1;
-    if (ValidateInput(algorithm, jpeg, algoBits, mode, outputFormat) != 0)
+    if (ValidateInput(algorithm, jpeg, algoBits, mode, outputFormat, lumaLayout) != 0)
     {
         Usage();
         return -2;
@@ -331,13 +607,7 @@ int main(int argc, char** argv)
     // If encoding, add all files supported by the DepthmapReader. If decoding, add all formats supported by the ImageReader
     std::vector<std::filesystem::path> files = GetFiles(inputDir, recursive, inDir, outDir, mode[0]);
 
-    if (algorithm == "HILBERT") hilbertCoder = StreamCoder<Hilbert>     (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "PACKED") packedCoder = StreamCoder<Packed3>       (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "SPLIT") splitCoder = StreamCoder<Split3>          (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "TRIANGLE") triangleCoder = StreamCoder<Triangle>  (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "PHASE") phaseCoder = StreamCoder<Phase>           (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "HUE") hueCoder = StreamCoder<Hue>                 (enlarge, true, algoBits, { 8,8,8 }, true);
-    if (algorithm == "MORTON") mortonCoder = StreamCoder<Morton>        (enlarge, true, algoBits, { 8,8,8 }, true);
+    SetupCoder(algorithm, enlarge, true, algoBits);
 
     for (auto file : files)
     {
@@ -353,20 +623,122 @@ int main(int argc, char** argv)
 
             float* rawData = reader.GetRawData();
             uint16_t* depthData = new uint16_t[dmData.Width * dmData.Height];
-            DepthProcessing::Quantize(depthData, rawData, 16, nElements);
+            std::vector<uint8_t> mask(nElements);
+            bool noData = DepthMask::Build(mask.data(), rawData, nElements) < nElements;
+            // With no-data, 0 is left for the holes, so that they're still told apart from the lowest depth once decoded
+            DepthRange range;
+            TileRanges ranges;
+            if (tileSize > 0)
+            {
+                ranges.TileSize = tileSize;
+                DepthProcessing::QuantizeTiled(depthData, rawData, dmData.Width, dmData.Height, tileSize, 16, ranges.Ranges, noData);
+
+                std::vector<uint8_t> rangesData;
+                ranges.Write(rangesData);
+                std::ofstream rangesFile(outPath + "_encoded.ranges", std::ios::out | std::ios::binary);
+                rangesFile.write((const char*)rangesData.data(), rangesData.size());
+            }
+            else
+                range = DepthProcessing::Quantize(depthData, rawData, 16, nElements, 1, 0, noData);
+
+            if (noData)
+            {
+                DepthMask::Fill(depthData, mask.data(), dmData.Width, dmData.Height);
+
+                std::vector<uint8_t> maskData;
+                DepthMask::Write(mask.data(), nElements, maskData);
+                std::ofstream maskFile(outPath + "_encoded.mask", std::ios::out | std::ios::binary);
+                maskFile.write((const char*)maskData.data(), maskData.size());
+            }
 
             uint8_t* encoded = new uint8_t[nElements * 3];
-            if (quantize)
+            // Stretching [1, 65535] again would give 0 back to valid values, tiles are already stretched to their own range
+            if (quantize && !noData && tileSize == 0)
                 DepthProcessing::Quantize(depthData, depthData, 16, nElements);
-            Encode(depthData, (Color*)encoded, nElements, algorithm);
 
-            if (outputFormat == "JPG") 
-                ImageWriter::WriteJPEG(outPath + "_encoded.jpg", encoded, dmData.Width, dmData.Height, jpeg);
-            else if (outputFormat == "PNG") 
+            // Tiles tuned by AUTO match the quantization ones, so that they span a single depth range
+            std::unique_ptr<TiledCoder> tiledCoder;
+            if (algorithm == "AUTO")
+            {
+                Autotuner tuner;
+                std::vector<TileHeader> candidates = Autotuner::DefaultCandidates();
+                for (TileHeader& candidate : candidates)
+                    candidate.Enlarge = enlarge;
+                tuner.setCandidates(candidates);
+                tuner.setQuality(jpeg);
+
+                TileGrid grid;
+                grid.TileSize = tileSize > 0 ? tileSize : AutoTileSize;
+                std::map<std::string, uint32_t> choices;
+                for (uint32_t y = 0; y < dmData.Height; y += grid.TileSize)
+                {
+                    for (uint32_t x = 0; x < dmData.Width; x += grid.TileSize)
+                    {
+                        TileHeader header = tuner.tune(depthData + y * dmData.Width + x, std::min(grid.TileSize, dmData.Width - x),
+                            std::min(grid.TileSize, dmData.Height - y), dmData.Width);
+                        header.Range = tileSize > 0 ? ranges.Ranges[grid.Tiles.size()] : range;
+                        grid.Tiles.push_back(header);
+                        choices[GetAlgorithmName(header.Coder) + " " + std::to_string(header.AlgoBits) + " bits"]++;
+                    }
+                }
+
+                std::cout << file.string() << ":";
+                for (const auto& choice : choices)
+                    std::cout << " " << choice.first << " (" << choice.second << " tiles)";
+                std::cout << std::endl;
+
+                std::vector<uint8_t> gridData;
+                grid.Write(gridData);
+                std::ofstream tileFile(outPath + "_encoded.tile", std::ios::out | std::ios::binary);
+                tileFile.write((const char*)gridData.data(), gridData.size());
+                tiledCoder = std::make_unique<TiledCoder>(grid, dmData.Width);
+            }
+
+            if (outputFormat == "DSD")
+                ImageWriter::WriteDSD(outPath + "_encoded.dsd", depthData, dmData.Width, dmData.Height, maxError);
+            else if (tiledCoder)
+                tiledCoder->encode((Color*)encoded, depthData, 0, dmData.Height);
+            else
+                Encode(depthData, (Color*)encoded, nElements, algorithm);
+
+            if (lumaLayout)
+                LumaLayout::Apply((Color*)encoded, (Color*)encoded, nElements, GetCoarseChannel(algorithm));
+
+            // AUTO tiles mix coders, and have been scored with the standard tables
+            std::vector<std::array<unsigned int, 64>> quantTables;
+            if (outputFormat == "JPG" && !lumaLayout && !tiledCoder)
+                quantTables = GetQuantTables((Color*)encoded, nElements, algorithm);
+
+            bool rateControlled = (targetSize > 0 || targetError >= 0) && (outputFormat == "JPG" || outputFormat == "LOSSY_WEBP");
+            if (rateControlled)
+                WriteRateControlled(outPath + (outputFormat == "JPG" ? "_encoded.jpg" : "_encoded.webp"), encoded, depthData,
+                    dmData.Width, dmData.Height, outputFormat, algorithm, tiledCoder.get(), lumaLayout, targetSize, targetError,
+                    quantTables);
+            else if (outputFormat == "JPG" && lumaLayout)
+                ImageWriter::WriteJPEG420(outPath + "_encoded.jpg", encoded, dmData.Width, dmData.Height, jpeg);
+            else if (outputFormat == "JPG" && parallelJpeg)
+                // Restart markers let the decoder split the file in bands, see ParallelJpegDecoder
+                ImageWriter::WriteJPEGParallel(outPath + "_encoded.jpg", encoded, dmData.Width, dmData.Height, jpeg, 0, quantTables);
+            else if (outputFormat == "JPG")
+                ImageWriter::WriteJPEG(outPath + "_encoded.jpg", encoded, dmData.Width, dmData.Height, jpeg, quantTables);
+            else if (outputFormat == "PNG")
+            {
+#ifdef DSTREAM_ENABLE_ZIP
+                // Same filter as WritePNG, with the bands deflated on every core
+                PngEncoder pngEncoder;
+                pngEncoder.setFilter(PngFilter::None);
+                ImageWriter::WritePNGParallel(outPath + "_encoded.png", encoded, dmData.Width, dmData.Height, pngEncoder);
+#else
                 ImageWriter::WritePNG(outPath + "_encoded.png", encoded, dmData.Width, dmData.Height);
+#endif
+            }
+            else if (outputFormat == "DSQ")
+                ImageWriter::WriteDSQ(outPath + "_encoded.dsq", encoded, dmData.Width, dmData.Height);
 #ifdef DSTREAM_ENABLE_WEBP
             else if (outputFormat == "WEBP")
                 ImageWriter::WriteWEBP(outPath + "_encoded.webp", encoded, dmData.Width, dmData.Height);
+            else if (outputFormat == "LOSSY_WEBP" && lumaLayout)
+                ImageWriter::WriteWEBP(outPath + "_encoded.webp", encoded, dmData.Width, dmData.Height, WebpSettings::LumaPriority(jpeg));
             else if (outputFormat == "LOSSY_WEBP")
                 ImageWriter::WriteWEBP(outPath + "_encoded.webp", encoded, dmData.Width, dmData.Height, jpeg);
             else if (outputFormat == "SPLIT_WEBP")
@@ -380,13 +752,253 @@ int main(int argc, char** argv)
             int width, height, comp;
             ImageReader::GetImageSize(file.string(), &width, &height, &comp, file.extension().string());
             uint32_t nElements = width * height;
+            int fullWidth = width, fullHeight = height;
 
             uint16_t* decoded = new uint16_t[nElements];
             uint8_t* encoded = new uint8_t[nElements * 3];
 
-            ImageReader::Read(file.string(), encoded, nElements * 3);
-            Decode(encoded, decoded, nElements, algorithm);
+            std::string ext = file.extension().string();
+            for (uint32_t i = 0; i < ext.length(); i++)
+                ext[i] = std::tolower(ext[i]);
+
+            std::unique_ptr<TiledCoder> tiledCoder;
+            if (algorithm == "AUTO")
+            {
+                std::filesystem::path tilePath = file;
+                tilePath.replace_extension(".tile");
+                std::ifstream tileFile(tilePath, std::ios::in | std::ios::binary);
+                std::vector<uint8_t> gridData((std::istreambuf_iterator<char>(tileFile)), std::istreambuf_iterator<char>());
+
+                TileGrid grid;
+                if (!grid.Read(gridData.data(), gridData.size()) || !grid.Covers(width, height))
+                {
+                    std::cerr << "Missing or invalid tile headers " << tilePath.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+                tiledCoder = std::make_unique<TiledCoder>(grid, width);
+            }
+            // Decodes a window of the frame, see TiledCoder::decode. Without AUTO the whole file has the same coder
+            auto decodeWindow = [&](uint8_t* input, uint16_t* output, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t scale) {
+                if (tiledCoder)
+                    tiledCoder->decode(output, (Color*)input, x, y, w, h, scale);
+                else
+                    Decode(input, output, w * h, algorithm);
+            };
+            auto decodeToDepth = [&](uint8_t* input, float* output, uint32_t firstRow, uint32_t nRows, const TileRanges& ranges, const uint8_t* mask) {
+                if (tiledCoder)
+                    tiledCoder->decodeToDepth(output, (Color*)input, firstRow, nRows, ranges, mask);
+                else
+                    DecodeToDepth(input, output, width, firstRow, nRows, ranges, mask, algorithm);
+            };
+
+            // Frames quantized in tiles are decoded straight to depth, the mask is needed before decoding them
+            TileRanges ranges;
+            std::filesystem::path rangesPath = file;
+            rangesPath.replace_extension(".ranges");
+            bool tiled = std::filesystem::exists(rangesPath);
+            if (tiled)
+            {
+                std::ifstream rangesFile(rangesPath, std::ios::in | std::ios::binary);
+                std::vector<uint8_t> rangesData((std::istreambuf_iterator<char>(rangesFile)), std::istreambuf_iterator<char>());
+                if (!ranges.Read(rangesData.data(), rangesData.size()) || !ranges.Covers(width, height) || roi.Width > 0 || previewScale > 1)
+                {
+                    std::cerr << "Invalid tile ranges " << rangesPath.string() << ", or not decoding the whole frame" << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+            }
+
+            std::vector<uint8_t> mask;
+            std::filesystem::path maskPath = file;
+            maskPath.replace_extension(".mask");
+            if (std::filesystem::exists(maskPath))
+            {
+                std::ifstream maskFile(maskPath, std::ios::in | std::ios::binary);
+                std::vector<uint8_t> maskData((std::istreambuf_iterator<char>(maskFile)), std::istreambuf_iterator<char>());
+                mask.resize(nElements);
+                if (!DepthMask::Read(maskData.data(), maskData.size(), mask.data(), nElements))
+                {
+                    std::cerr << "Invalid no-data mask " << maskPath.string() << std::endl;
+                    mask.clear();
+                }
+            }
+            const uint8_t* frameMask = mask.empty() ? nullptr : mask.data();
+            std::vector<float> depth(tiled ? nElements : 0);
+
+            if (roi.Width > 0 && (roi.X + roi.Width > width || roi.Y + roi.Height > height))
+            {
+                std::cerr << "The region of interest is outside of " << file.string() << std::endl;
+                delete[] decoded;
+                delete[] encoded;
+                continue;
+            }
+
+            if (ext == ".dsd")
+            {
+                // Depth is stored without colours, there's no decode to fuse the tile ranges with
+                if (!ImageReader::ReadDSD(file.string(), decoded))
+                {
+                    std::cerr << "Could not decode " << file.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+                if (tiled)
+                {
+                    DepthProcessing::DequantizeTiled(depth.data(), decoded, width, height, ranges.TileSize, ranges.Ranges);
+                    for (uint32_t i = 0; frameMask && i < nElements; i++)
+                        if (!frameMask[i])
+                            depth[i] = std::numeric_limits<float>::quiet_NaN();
+                }
+                if (roi.Width > 0)
+                {
+                    for (int y = 0; y < roi.Height; y++)
+                        memmove(decoded + y * roi.Width, decoded + (roi.Y + y) * width + roi.X, roi.Width * sizeof(uint16_t));
+                    width = roi.Width;
+                    height = roi.Height;
+                    nElements = width * height;
+                }
+            }
+            else if (roi.Width > 0)
+            {
+                bool yuvPassthrough = lumaLayout && ext != ".png" && ext != ".dsq";
+                if (!ImageReader::ReadRegion(file.string(), roi.X, roi.Y, roi.Width, roi.Height, encoded, roi.Width * 3, yuvPassthrough))
+                {
+                    std::cerr << "Could not read the region of interest of " << file.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+                width = roi.Width;
+                height = roi.Height;
+                nElements = width * height;
+
+                if (yuvPassthrough)
+                    LumaLayout::Revert((Color*)encoded, (Color*)encoded, nElements, GetCoarseChannel(algorithm));
+                decodeWindow(encoded, decoded, roi.X, roi.Y, width, height, 1);
+            }
+            else if ((ext == ".jpg" || ext == ".jpeg") && previewScale > 1)
+            {
+                std::ifstream jpegFile(file, std::ios::in | std::ios::binary);
+                std::vector<uint8_t> jpegData((std::istreambuf_iterator<char>(jpegFile)), std::istreambuf_iterator<char>());
+
+                JpegDecoder decoder;
+                if (lumaLayout)
+                {
+                    // Chroma is replicated like LumaLayout::FromPlanar420 does, and like region decodes do
+                    decoder.setColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+                    decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+                    decoder.setFancyUpsampling(false);
+                }
+                else
+                    decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+                decoder.setScale(previewScale);
+                if (!decoder.decodeNonAlloc(jpegData.data(), jpegData.size(), encoded, width, height))
+                {
+                    std::cerr << "Could not decode " << file.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+                nElements = width * height;
+
+                if (lumaLayout)
+                    LumaLayout::Revert((Color*)encoded, (Color*)encoded, nElements, GetCoarseChannel(algorithm));
+                decodeWindow(encoded, decoded, 0, 0, width, height, previewScale);
+                // Blocks across a depth discontinuity average colours that don't belong to the coding curve, and
+                // decode to isolated outliers
+                DepthProcessing::RemoveSpikes(decoded, width, height);
+            }
+            else if (ext == ".jpg" || ext == ".jpeg")
+            {
+                // JPEGs with restart markers are decoded in bands, each one is decoded as soon as it's ready
+                std::ifstream jpegFile(file, std::ios::in | std::ios::binary);
+                std::vector<uint8_t> jpegData((std::istreambuf_iterator<char>(jpegFile)), std::istreambuf_iterator<char>());
+
+                ParallelJpegDecoder decoder;
+                if (lumaLayout)
+                {
+                    // Chroma is replicated like LumaLayout::FromPlanar420 does, and like region decodes do
+                    decoder.setColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+                    decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_YCbCr);
+                    decoder.setFancyUpsampling(false);
+                }
+                else
+                    decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+
+                // Bands are decoded on several threads at once, StreamCoder::Decode is thread safe without a decode cache
+                uint8_t coarseChannel = GetCoarseChannel(algorithm);
+                bool success = decoder.decode(jpegData.data(), jpegData.size(), encoded, width, height, [&](int firstRow, int nRows) {
+                    Color* band = (Color*)(encoded + firstRow * width * 3);
+                    if (lumaLayout)
+                        LumaLayout::Revert(band, band, nRows * width, coarseChannel);
+                    if (tiled)
+                        decodeToDepth((uint8_t*)band, depth.data() + firstRow * width, firstRow, nRows, ranges,
+                            frameMask ? frameMask + firstRow * width : nullptr);
+                    else
+                        decodeWindow((uint8_t*)band, decoded + firstRow * width, 0, firstRow, width, nRows, 1);
+                });
+
+                if (!success)
+                {
+                    std::cerr << "Could not decode " << file.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+            }
+#ifdef DSTREAM_ENABLE_WEBP
+            else if (ext == ".webp" && lumaLayout)
+            {
+                ImageReader::ReadWEBP(file.string(), encoded, nElements * 3, true);
+                LumaLayout::Revert((Color*)encoded, (Color*)encoded, nElements, GetCoarseChannel(algorithm));
+                if (tiled)
+                    decodeToDepth(encoded, depth.data(), 0, height, ranges, frameMask);
+                else
+                    decodeWindow(encoded, decoded, 0, 0, width, height, 1);
+            }
+#endif
+            else
+            {
+                // Corrupted DSQ files are detected by the decoder
+                bool success = true;
+                if (ext == ".dsq")
+                    success = ImageReader::ReadDSQ(file.string(), encoded);
+                else
+                    ImageReader::Read(file.string(), encoded, nElements * 3);
+                if (!success)
+                {
+                    std::cerr << "Could not decode " << file.string() << std::endl;
+                    delete[] decoded;
+                    delete[] encoded;
+                    continue;
+                }
+
+                if (tiled)
+                    decodeToDepth(encoded, depth.data(), 0, height, ranges, frameMask);
+                else
+                    decodeWindow(encoded, decoded, 0, 0, width, height, 1);
+            }
+
+            if (!mask.empty() && !tiled)
+            {
+                // Previews take the mask value at the centre of their block, regions the one of their window
+                if (width != fullWidth || height != fullHeight)
+                {
+                    for (int y = 0; y < height; y++)
+                        for (int x = 0; x < width; x++)
+                            mask[y * width + x] = mask[std::min(roi.Y + y * previewScale + previewScale / 2, fullHeight - 1) * fullWidth +
+                                std::min(roi.X + x * previewScale + previewScale / 2, fullWidth - 1)];
+                }
+                DepthMask::Apply(decoded, mask.data(), nElements);
+            }
 
+            // The texture of a tiled frame shows its depth quantized to the range of the whole frame
+            if (tiled && saveDecoded)
+                DepthProcessing::Quantize(decoded, depth.data(), 16, nElements, 1, 0, frameMask != nullptr);
             if (saveDecoded)
                 ImageWriter::WriteDecoded(outPath + "_decoded.png", decoded, width, height);
 
@@ -399,7 +1011,7 @@ int main(int argc, char** argv)
             for (uint32_t y = 0; y < height; y++)
             {
                 for (uint32_t x=0; x<width; x++)
-                    ss << std::to_string(decoded[y * width + x]) + ",";
+                    ss << (tiled ? std::to_string(depth[y * width + x]) : std::to_string(decoded[y * width + x])) + ",";
                 ss << '\n';
             }
 
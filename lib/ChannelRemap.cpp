@@ -0,0 +1,79 @@
+#include <ChannelRemap.h>
+#include <Simd.h>
+
+namespace DStream
+{
+#ifdef DSTREAM_X86
+	// vpermi2b looks up 64 bytes at a time in a 128 entries table, the 8th bit of the index chooses between
+	// two of them. The three maps are looked up on every byte and the results are merged according to the channel
+	// of each byte, the pattern repeats every 3 vectors.
+	DSTREAM_TARGET("avx512f,avx512bw,avx512vbmi") static uint32_t ApplyVBMI(uint8_t* dest, const uint8_t* source, uint32_t nBytes,
+		const uint8_t* const maps[3])
+	{
+		__m512i tables[3][4];
+		for (uint32_t c = 0; c < 3; c++)
+			for (uint32_t k = 0; k < 4; k++)
+				tables[c][k] = _mm512_loadu_si512(maps[c] + k * 64);
+
+		__mmask64 masks[3][3] = {};
+		for (uint32_t v = 0; v < 3; v++)
+			for (uint32_t j = 0; j < 64; j++)
+				masks[v][(v * 64 + j) % 3] |= 1ull << j;
+
+		uint32_t i = 0;
+		for (; i + 192 <= nBytes; i += 192)
+		{
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				__m512i x = _mm512_loadu_si512(source + i + v * 64);
+				__mmask64 high = _mm512_movepi8_mask(x);
+				__m512i ret = _mm512_setzero_si512();
+
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					__m512i lo = _mm512_permutex2var_epi8(tables[c][0], x, tables[c][1]);
+					__m512i hi = _mm512_permutex2var_epi8(tables[c][2], x, tables[c][3]);
+					ret = _mm512_mask_mov_epi8(ret, masks[v][c], _mm512_mask_blend_epi8(high, lo, hi));
+				}
+
+				_mm512_storeu_si512(dest + i + v * 64, ret);
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	void ChannelRemap::Apply(Color* dest, const Color* source, uint32_t nElements, const uint8_t* mapX, const uint8_t* mapY, const uint8_t* mapZ)
+	{
+		uint8_t* out = (uint8_t*)dest;
+		const uint8_t* in = (const uint8_t*)source;
+		uint32_t nBytes = nElements * 3;
+		uint32_t i = 0;
+
+		// 16 pshufb per 256 entries map and per channel end up slower than plain lookups on SSE / AVX2
+#ifdef DSTREAM_X86
+		if (CpuFeatures::Get().AVX512VBMI)
+		{
+			const uint8_t* maps[3] = { mapX, mapY, mapZ };
+			i = ApplyVBMI(out, in, nBytes, maps);
+		}
+#endif
+
+		for (; i + 12 <= nBytes; i += 12)
+		{
+			uint8_t x0 = in[i], y0 = in[i + 1], z0 = in[i + 2], x1 = in[i + 3], y1 = in[i + 4], z1 = in[i + 5];
+			uint8_t x2 = in[i + 6], y2 = in[i + 7], z2 = in[i + 8], x3 = in[i + 9], y3 = in[i + 10], z3 = in[i + 11];
+			out[i] = mapX[x0]; out[i + 1] = mapY[y0]; out[i + 2] = mapZ[z0];
+			out[i + 3] = mapX[x1]; out[i + 4] = mapY[y1]; out[i + 5] = mapZ[z1];
+			out[i + 6] = mapX[x2]; out[i + 7] = mapY[y2]; out[i + 8] = mapZ[z2];
+			out[i + 9] = mapX[x3]; out[i + 10] = mapY[y3]; out[i + 11] = mapZ[z3];
+		}
+		for (; i < nBytes; i += 3)
+		{
+			out[i] = mapX[in[i]];
+			out[i + 1] = mapY[in[i + 1]];
+			out[i + 2] = mapZ[in[i + 2]];
+		}
+	}
+}
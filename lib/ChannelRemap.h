@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <DataStructs/Vec3.h>
+
+namespace DStream
+{
+	// Applies a 256 entries byte map to each channel of interleaved RGB colours. dest can be the same as source.
+	class ChannelRemap
+	{
+	public:
+		static void Apply(Color* dest, const Color* source, uint32_t nElements, const uint8_t* mapX, const uint8_t* mapY, const uint8_t* mapZ);
+	};
+}
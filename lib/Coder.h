@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <type_traits>
+#include <utility>
 #include <DataStructs/Table.h>
 #include <DataStructs/Vec3.h>
 
@@ -13,8 +15,11 @@ namespace DStream
 
 		virtual inline bool SupportsInterpolation() { return true; }
 		virtual inline bool SupportsEnlarge() { return false; }
+		// Channel that carries the most significant part of the value
+		virtual inline uint8_t GetCoarseChannel() { return 0; }
 
 		inline uint8_t GetAlgoBits() { return m_AlgoBits; }
+		inline const std::vector<uint8_t>& GetChannelDistribution() { return m_ChannelDistribution; }
 		inline std::string GetName() { return m_Name; }
 
 	protected:
@@ -22,4 +27,19 @@ namespace DStream
 		std::vector<uint8_t> m_ChannelDistribution;
 		std::string m_Name;
 	};
+
+	// Coders that implement DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements) get it
+	// called by the StreamCoder instead of DecodeValue on every pixel
+	template <typename T, typename = void>
+	struct HasDecodeBatch : std::false_type {};
+
+	template <typename T>
+	struct HasDecodeBatch<T, std::void_t<decltype(std::declval<T&>().DecodeBatch((uint16_t*)nullptr, (const Color*)nullptr, 0u))>> : std::true_type {};
+
+	// Same for EncodeBatch(Color* dest, const uint16_t* source, uint32_t nElements) and EncodeValue
+	template <typename T, typename = void>
+	struct HasEncodeBatch : std::false_type {};
+
+	template <typename T>
+	struct HasEncodeBatch<T, std::void_t<decltype(std::declval<T&>().EncodeBatch((Color*)nullptr, (const uint16_t*)nullptr, 0u))>> : std::true_type {};
 }
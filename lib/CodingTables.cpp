@@ -0,0 +1,75 @@
+#include <CodingTables.h>
+#include <HugePages.h>
+
+#include <new>
+
+namespace DStream
+{
+	CodingTables::CodingTables(TableLayout layout, bool lazy /* = false*/) : m_Layout(layout), m_Lazy(lazy), m_ReadyBlocks(0)
+	{
+		m_BlockReady = std::unique_ptr<std::atomic<uint8_t>[]>(new std::atomic<uint8_t>[BlockCount]);
+		for (uint32_t i = 0; i < BlockCount; i++)
+			m_BlockReady[i].store(lazy ? 0 : 1, std::memory_order_relaxed);
+
+		// The decoding table comes first so that it starts on a huge page boundary
+		m_MemorySize = DecodingTableSize * sizeof(uint16_t) + EncodingTableSize * sizeof(Color);
+		m_Memory = (uint8_t*)HugePages::Allocate(m_MemorySize);
+		if (m_Memory == nullptr)
+			throw std::bad_alloc();
+
+		m_DecodingTable = (uint16_t*)m_Memory;
+		m_EncodingTable = (Color*)(m_Memory + DecodingTableSize * sizeof(uint16_t));
+	}
+
+	CodingTables::~CodingTables()
+	{
+		HugePages::Free(m_Memory, m_MemorySize);
+	}
+
+	void CodingTables::FillBlock(uint32_t block, const std::function<void(uint32_t, uint16_t*)>& fill) const
+	{
+		std::lock_guard<std::mutex> lock(m_BlockMutexes[block % BlockMutexCount]);
+		if (IsBlockReady(block))
+			return;
+
+		fill(block, m_DecodingTable);
+		m_BlockReady[block].store(1, std::memory_order_release);
+		m_ReadyBlocks.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	std::shared_ptr<const CodingTables> TableRegistry::Acquire(const std::string& key, TableLayout layout, bool lazy, const std::function<void(CodingTables&)>& build)
+	{
+		std::shared_ptr<Entry> entry;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			// Drop entries whose tables have been released
+			for (auto it = m_Entries.begin(); it != m_Entries.end();)
+			{
+				if (it->second->Tables.expired() && it->second.use_count() == 1 && it->first != key)
+					it = m_Entries.erase(it);
+				else
+					it++;
+			}
+
+			std::shared_ptr<Entry>& slot = m_Entries[key];
+			if (slot == nullptr)
+				slot = std::make_shared<Entry>();
+			entry = slot;
+		}
+
+		// Only coders asking for the same tables wait for each other
+		std::lock_guard<std::mutex> lock(entry->Mutex);
+		std::shared_ptr<const CodingTables> tables = entry->Tables.lock();
+		if (tables == nullptr)
+		{
+			std::shared_ptr<CodingTables> built = std::make_shared<CodingTables>(layout, lazy);
+			build(*built);
+
+			tables = built;
+			entry->Tables = tables;
+		}
+
+		return tables;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include <DataStructs/Table.h>
+#include <DataStructs/Vec3.h>
+
+namespace DStream
+{
+	// Encoding (65536 colours) and decoding (256^3 values) tables of a StreamCoder. Both live in a single
+	// allocation backed by huge pages. Once built, tables are shared as immutable objects.
+	// Lazy tables split the RGB cube in 16^3 blocks: the decoding table of a block is computed the
+	// first time one of its colours is decoded. Blocks are filled exactly once, even if they're
+	// requested by multiple threads at the same time.
+	class CodingTables
+	{
+	public:
+		static const uint32_t EncodingTableSize = 1 << 16;
+		static const uint32_t DecodingTableSize = 1 << 24;
+		static const uint32_t BlockSide = 16;
+		static const uint32_t BlockCount = (256 / BlockSide) * (256 / BlockSide) * (256 / BlockSide);
+
+		CodingTables(TableLayout layout, bool lazy = false);
+		~CodingTables();
+
+		CodingTables(const CodingTables&) = delete;
+		void operator=(const CodingTables&) = delete;
+
+		inline const Color* GetEncodingTable() const { return m_EncodingTable; }
+		inline const uint16_t* GetDecodingTable() const { return m_DecodingTable; }
+		inline TableLayout GetLayout() const { return m_Layout; }
+
+		inline bool IsLazy() const { return m_Lazy; }
+		inline bool IsComplete() const { return !m_Lazy || m_ReadyBlocks.load(std::memory_order_acquire) == BlockCount; }
+		inline bool IsBlockReady(uint32_t block) const { return m_BlockReady[block].load(std::memory_order_acquire) != 0; }
+		// Fills the decoding table of the block if no one did it yet. fill receives the block index and the decoding table
+		void FillBlock(uint32_t block, const std::function<void(uint32_t, uint16_t*)>& fill) const;
+
+		static inline uint32_t GetBlock(uint8_t r, uint8_t g, uint8_t b) { return ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4); }
+
+		// Only meant to be used while the tables are being built
+		inline Color* GetEncodingData() { return m_EncodingTable; }
+		inline uint16_t* GetDecodingData() { return m_DecodingTable; }
+
+	private:
+		static const uint32_t BlockMutexCount = 64;
+
+		TableLayout m_Layout;
+		bool m_Lazy;
+
+		std::unique_ptr<std::atomic<uint8_t>[]> m_BlockReady;
+		mutable std::atomic<uint32_t> m_ReadyBlocks;
+		mutable std::mutex m_BlockMutexes[BlockMutexCount];
+
+		uint8_t* m_Memory;
+		size_t m_MemorySize;
+
+		uint16_t* m_DecodingTable;
+		Color* m_EncodingTable;
+	};
+
+	// Process-wide cache of the generated tables. Coders with the same parameters get the same tables,
+	// which are released once the last coder using them is destroyed.
+	class TableRegistry
+	{
+	public:
+		std::shared_ptr<const CodingTables> Acquire(const std::string& key, TableLayout layout, bool lazy, const std::function<void(CodingTables&)>& build);
+
+		inline static TableRegistry& Get()
+		{
+			static TableRegistry instance;
+			return instance;
+		}
+
+	private:
+		struct Entry
+		{
+			std::mutex Mutex;
+			std::weak_ptr<const CodingTables> Tables;
+		};
+
+		std::mutex m_Mutex;
+		std::unordered_map<std::string, std::shared_ptr<Entry>> m_Entries;
+	};
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace DStream
+{
+	// Counters are atomic, so that Decode can run on several threads at once, like from the band callbacks of
+	// ParallelJpegDecoder
+	struct CoderStats
+	{
+		std::atomic<uint64_t> DecodedValues = 0;
+
+		// Decode cache, only updated when the cache is enabled
+		std::atomic<uint64_t> CacheLookups = 0;
+		std::atomic<uint64_t> CacheHits = 0;
+
+		CoderStats() = default;
+		CoderStats(const CoderStats& other) { *this = other; }
+
+		inline CoderStats& operator=(const CoderStats& other)
+		{
+			DecodedValues = other.DecodedValues.load();
+			CacheLookups = other.CacheLookups.load();
+			CacheHits = other.CacheHits.load();
+			return *this;
+		}
+
+		inline float GetCacheHitRate() const { return CacheLookups == 0 ? 0.0f : (float)CacheHits / CacheLookups; }
+	};
+}
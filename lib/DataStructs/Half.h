@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace DStream
+{
+	// IEEE 754 binary16, for consumers that upload depth to the GPU as half floats
+	struct Half
+	{
+		uint16_t Bits;
+
+		// Rounds to nearest even, values out of range become infinities and NaNs stay NaNs
+		static inline Half FromFloat(float value)
+		{
+			const uint32_t infinity = 255u << 23;
+			const uint32_t halfMax = (127u + 16) << 23;
+			const uint32_t denormalMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+			uint32_t x;
+			memcpy(&x, &value, 4);
+			uint32_t sign = x & 0x80000000u;
+			x ^= sign;
+
+			uint16_t ret;
+			if (x >= halfMax)
+				ret = x > infinity ? 0x7E00 : 0x7C00;
+			else if (x < (113u << 23))
+			{
+				// The float addition aligns the mantissa to the denormal half and rounds it
+				float f, magic;
+				memcpy(&f, &x, 4);
+				memcpy(&magic, &denormalMagic, 4);
+				f += magic;
+				memcpy(&x, &f, 4);
+				ret = (uint16_t)(x - denormalMagic);
+			}
+			else
+			{
+				uint32_t odd = (x >> 13) & 1;
+				x += 0xFFF - (112u << 23) + odd;
+				ret = (uint16_t)(x >> 13);
+			}
+
+			return { (uint16_t)(ret | (sign >> 16)) };
+		}
+
+		inline float ToFloat() const
+		{
+			const uint32_t shiftedExponent = 0x7C00u << 13;
+			const uint32_t magicBits = 113u << 23;
+
+			uint32_t x = (uint32_t)(Bits & 0x7FFF) << 13;
+			uint32_t exponent = x & shiftedExponent;
+			x += (127u - 15) << 23;
+
+			float ret;
+			if (exponent == shiftedExponent)
+				x += (128u - 16) << 23;
+			else if (exponent == 0)
+			{
+				float magic;
+				x += 1u << 23;
+				memcpy(&ret, &x, 4);
+				memcpy(&magic, &magicBits, 4);
+				ret -= magic;
+				memcpy(&x, &ret, 4);
+			}
+
+			x |= (uint32_t)(Bits & 0x8000) << 16;
+			memcpy(&ret, &x, 4);
+			return ret;
+		}
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <DataStructs/Vec3.h>
+
+namespace DStream
+{
+	// Planar has a separate plane of bytes for each of R, G and B
+	enum class PixelFormat : uint8_t { RGB = 0, BGR, RGBA, BGRA, Planar };
+
+	// Colours in a buffer owned by the caller, with rows Stride bytes apart. Interleaved formats only use Planes[0].
+	// Used as a source the data is only read, alpha is set to 255 when colours are written to it
+	struct ImageView
+	{
+		uint8_t* Planes[3] = { nullptr, nullptr, nullptr };
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		size_t Stride = 0;
+		PixelFormat Format = PixelFormat::RGB;
+
+		// A stride of 0 means tightly packed rows
+		static inline ImageView Interleaved(uint8_t* data, uint32_t width, uint32_t height, PixelFormat format, size_t stride = 0)
+		{
+			ImageView view;
+			view.Planes[0] = data;
+			view.Width = width;
+			view.Height = height;
+			view.Format = format;
+			view.Stride = stride ? stride : (size_t)width * GetPixelSize(format);
+			return view;
+		}
+
+		static inline ImageView Planar(uint8_t* r, uint8_t* g, uint8_t* b, uint32_t width, uint32_t height, size_t stride = 0)
+		{
+			ImageView view;
+			view.Planes[0] = r;
+			view.Planes[1] = g;
+			view.Planes[2] = b;
+			view.Width = width;
+			view.Height = height;
+			view.Format = PixelFormat::Planar;
+			view.Stride = stride ? stride : width;
+			return view;
+		}
+
+		static inline uint32_t GetPixelSize(PixelFormat format)
+		{
+			switch (format)
+			{
+			case PixelFormat::RGBA:
+			case PixelFormat::BGRA:		return 4;
+			case PixelFormat::Planar:	return 1;
+			default:					return 3;
+			}
+		}
+
+		// Tightly packed RGB rows can be coded in place, without going through Load and Store
+		inline bool IsPackedRGB() const { return Format == PixelFormat::RGB && Stride == (size_t)Width * 3; }
+
+		// Copies n colours of row y starting at column x to dest
+		inline void Load(uint32_t x, uint32_t y, uint32_t n, Color* dest) const
+		{
+			const uint8_t* row = Planes[0] + y * Stride;
+			switch (Format)
+			{
+			case PixelFormat::RGB:
+				memcpy(dest, row + x * 3, n * 3);
+				break;
+			case PixelFormat::BGR:
+				for (uint32_t i = 0; i < n; i++)
+					dest[i] = Color(row[(x + i) * 3 + 2], row[(x + i) * 3 + 1], row[(x + i) * 3]);
+				break;
+			case PixelFormat::RGBA:
+				for (uint32_t i = 0; i < n; i++)
+					dest[i] = Color(row[(x + i) * 4], row[(x + i) * 4 + 1], row[(x + i) * 4 + 2]);
+				break;
+			case PixelFormat::BGRA:
+				for (uint32_t i = 0; i < n; i++)
+					dest[i] = Color(row[(x + i) * 4 + 2], row[(x + i) * 4 + 1], row[(x + i) * 4]);
+				break;
+			case PixelFormat::Planar:
+			{
+				const uint8_t* g = Planes[1] + y * Stride;
+				const uint8_t* b = Planes[2] + y * Stride;
+				for (uint32_t i = 0; i < n; i++)
+					dest[i] = Color(row[x + i], g[x + i], b[x + i]);
+				break;
+			}
+			}
+		}
+
+		// Copies n colours from source to row y starting at column x
+		inline void Store(uint32_t x, uint32_t y, uint32_t n, const Color* source) const
+		{
+			uint8_t* row = Planes[0] + y * Stride;
+			switch (Format)
+			{
+			case PixelFormat::RGB:
+				memcpy(row + x * 3, source, n * 3);
+				break;
+			case PixelFormat::BGR:
+				for (uint32_t i = 0; i < n; i++)
+				{
+					uint8_t* px = row + (x + i) * 3;
+					px[0] = source[i].z; px[1] = source[i].y; px[2] = source[i].x;
+				}
+				break;
+			case PixelFormat::RGBA:
+				for (uint32_t i = 0; i < n; i++)
+				{
+					uint8_t* px = row + (x + i) * 4;
+					px[0] = source[i].x; px[1] = source[i].y; px[2] = source[i].z; px[3] = 255;
+				}
+				break;
+			case PixelFormat::BGRA:
+				for (uint32_t i = 0; i < n; i++)
+				{
+					uint8_t* px = row + (x + i) * 4;
+					px[0] = source[i].z; px[1] = source[i].y; px[2] = source[i].x; px[3] = 255;
+				}
+				break;
+			case PixelFormat::Planar:
+			{
+				uint8_t* g = Planes[1] + y * Stride;
+				uint8_t* b = Planes[2] + y * Stride;
+				for (uint32_t i = 0; i < n; i++)
+				{
+					row[x + i] = source[i].x;
+					g[x + i] = source[i].y;
+					b[x + i] = source[i].z;
+				}
+				break;
+			}
+			}
+		}
+	};
+}
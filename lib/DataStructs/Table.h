@@ -10,4 +10,48 @@ namespace DStream
 		std::vector<uint8_t> Enlarge[3];
 		std::vector<uint8_t> Shrink[3];
 	};
+
+	// Memory layout of the 256^3 decoding table. Linear is plain row-major (r*65536 + g*256 + b),
+	// Blocked groups the cube in 8x8x8 bricks of 1KB, Morton interleaves the bits of the three channels
+	// so that colours that are close in RGB space are close in memory too
+	enum class TableLayout { Linear = 0, Blocked, Morton };
+
+	namespace TableIndex
+	{
+		inline uint32_t Linear(uint8_t r, uint8_t g, uint8_t b)
+		{
+			return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+		}
+
+		inline uint32_t Blocked(uint8_t r, uint8_t g, uint8_t b)
+		{
+			uint32_t brick = ((uint32_t)(r >> 3) << 19) | ((uint32_t)(g >> 3) << 14) | ((uint32_t)(b >> 3) << 9);
+			return brick | ((r & 7) << 6) | ((g & 7) << 3) | (b & 7);
+		}
+
+		// Spreads the 8 bits of a channel so that there are 2 empty bits between each of them
+		inline uint32_t Spread(uint8_t v)
+		{
+			uint32_t x = v;
+			x = (x | (x << 8)) & 0x00F00F;
+			x = (x | (x << 4)) & 0x0C30C3;
+			x = (x | (x << 2)) & 0x249249;
+			return x;
+		}
+
+		inline uint32_t Morton(uint8_t r, uint8_t g, uint8_t b)
+		{
+			return (Spread(r) << 2) | (Spread(g) << 1) | Spread(b);
+		}
+
+		inline uint32_t Get(TableLayout layout, uint8_t r, uint8_t g, uint8_t b)
+		{
+			switch (layout)
+			{
+			case TableLayout::Blocked:	return Blocked(r, g, b);
+			case TableLayout::Morton:	return Morton(r, g, b);
+			default:					return Linear(r, g, b);
+			}
+		}
+	}
 }
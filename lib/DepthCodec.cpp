@@ -0,0 +1,357 @@
+#include <DepthCodec.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#include <intrin.h>
+#endif
+
+namespace DStream
+{
+	static const uint32_t RansLowerBound = 1u << 23;
+	static const uint32_t ProbabilityScale = 1u << DepthCodec::ProbabilityBits;
+	static const uint32_t TablesSize = DepthCodec::ContextCount * DepthCodec::TokenCount * 2;
+
+	static inline uint32_t BitLength(uint32_t v)
+	{
+		if (v == 0)
+			return 0;
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanReverse(&index, v);
+		return index + 1;
+#else
+		return 32 - __builtin_clz(v);
+#endif
+	}
+
+	static inline void WriteLE(uint8_t* dest, uint32_t v, uint32_t bytes)
+	{
+		for (uint32_t i = 0; i < bytes; i++)
+			dest[i] = v >> (i * 8);
+	}
+
+	static inline uint32_t ReadLE(const uint8_t* src, uint32_t bytes)
+	{
+		uint32_t v = 0;
+		for (uint32_t i = 0; i < bytes; i++)
+			v |= (uint32_t)src[i] << (i * 8);
+		return v;
+	}
+
+	// Neighbourhood of a pixel, made of already decoded values: the first row only sees the left neighbour,
+	// the first column uses the pixel above in place of the left ones
+	struct Neighbours
+	{
+		int A, B, C, D;
+
+		inline Neighbours(const uint16_t* data, uint32_t x, uint32_t y, uint32_t width)
+		{
+			const uint16_t* row = data + (size_t)y * width;
+			if (y == 0)
+			{
+				A = B = C = D = x > 0 ? row[x - 1] : 0;
+				return;
+			}
+
+			const uint16_t* up = row - width;
+			B = up[x];
+			D = x + 1 < width ? up[x + 1] : B;
+			if (x == 0)
+				A = C = B;
+			else
+			{
+				A = row[x - 1];
+				C = up[x - 1];
+			}
+		}
+
+		inline int Predict() const
+		{
+			if (C >= std::max(A, B))
+				return std::min(A, B);
+			if (C <= std::min(A, B))
+				return std::max(A, B);
+			return A + B - C;
+		}
+
+		inline uint32_t Context(int step) const
+		{
+			uint32_t gradient = std::abs(D - B) + std::abs(B - C) + std::abs(C - A);
+			return std::min(DepthCodec::ContextCount - 1, BitLength(gradient / step));
+		}
+	};
+
+	// JPEG-LS reconstruction: residuals are reduced modulo range, values that fall outside [-maxError, 65535 + maxError]
+	// are brought back before clamping
+	static inline uint16_t Reconstruct(int prediction, int residual, int maxError, int step, int range)
+	{
+		int value = prediction + residual * step;
+		if (value < -maxError)
+			value += range * step;
+		else if (value > 65535 + maxError)
+			value -= range * step;
+		return (uint16_t)std::clamp(value, 0, 65535);
+	}
+
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<uint8_t>& out) : m_Out(out) {}
+
+		inline void Put(uint32_t value, uint32_t nBits)
+		{
+			m_Buffer |= (uint64_t)value << m_Count;
+			m_Count += nBits;
+			while (m_Count >= 8)
+			{
+				m_Out.push_back((uint8_t)m_Buffer);
+				m_Buffer >>= 8;
+				m_Count -= 8;
+			}
+		}
+
+		inline void Flush()
+		{
+			if (m_Count > 0)
+				m_Out.push_back((uint8_t)m_Buffer);
+			m_Buffer = 0;
+			m_Count = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& m_Out;
+		uint64_t m_Buffer = 0;
+		uint32_t m_Count = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, const uint8_t* end) : m_Data(data), m_End(end) {}
+
+		inline uint32_t Get(uint32_t nBits)
+		{
+			while (m_Count < nBits)
+			{
+				m_Buffer |= (uint64_t)(m_Data < m_End ? *m_Data++ : 0) << m_Count;
+				m_Count += 8;
+			}
+
+			uint32_t ret = m_Buffer & ((1ull << nBits) - 1);
+			m_Buffer >>= nBits;
+			m_Count -= nBits;
+			return ret;
+		}
+
+	private:
+		const uint8_t* m_Data;
+		const uint8_t* m_End;
+		uint64_t m_Buffer = 0;
+		uint32_t m_Count = 0;
+	};
+
+	// Scales the counts so that they sum to ProbabilityScale, keeping every used token representable
+	static void NormalizeFrequencies(const uint32_t* counts, uint16_t* freqs)
+	{
+		uint64_t total = 0;
+		for (uint32_t s = 0; s < DepthCodec::TokenCount; s++)
+			total += counts[s];
+
+		memset(freqs, 0, DepthCodec::TokenCount * sizeof(uint16_t));
+		if (total == 0)
+			return;
+
+		uint32_t assigned = 0, largest = 0;
+		for (uint32_t s = 0; s < DepthCodec::TokenCount; s++)
+		{
+			if (counts[s] == 0)
+				continue;
+
+			freqs[s] = std::max<uint64_t>(1, counts[s] * ProbabilityScale / total);
+			assigned += freqs[s];
+			if (counts[s] > counts[largest])
+				largest = s;
+		}
+		freqs[largest] += ProbabilityScale - assigned;
+	}
+
+	bool DepthCodec::ReadHeader(const uint8_t* source, size_t size, uint32_t& width, uint32_t& height, uint16_t& maxError)
+	{
+		if (size < HeaderSize + TablesSize + 4 || memcmp(source, "dsd1", 4) != 0)
+			return false;
+
+		width = ReadLE(source + 4, 4);
+		height = ReadLE(source + 8, 4);
+		maxError = ReadLE(source + 12, 2);
+		return width > 0 && height > 0;
+	}
+
+	void DepthCodec::Encode(const uint16_t* source, uint32_t width, uint32_t height, std::vector<uint8_t>& dest, uint16_t maxError /* = 0*/)
+	{
+		uint32_t nElements = width * height;
+		int step = 2 * maxError + 1;
+		int range = (65535 + 2 * maxError) / step + 1;
+
+		// Near lossless coding predicts from the reconstructed values, like the decoder will
+		std::vector<uint16_t> reconstructed;
+		const uint16_t* reference = source;
+		if (maxError > 0)
+		{
+			reconstructed.resize(nElements);
+			reference = reconstructed.data();
+		}
+
+		std::vector<uint8_t> tokens(nElements), contexts(nElements), extraBits;
+		uint32_t counts[ContextCount][TokenCount] = {};
+		BitWriter bits(extraBits);
+		extraBits.reserve(nElements);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t i = y * width + x;
+				Neighbours n(reference, x, y, width);
+				int prediction = n.Predict();
+				int error = (int)source[i] - prediction;
+
+				int residual = error > 0 ? (error + maxError) / step : -((maxError - error) / step);
+				if (residual < 0)
+					residual += range;
+				if (residual >= (range + 1) / 2)
+					residual -= range;
+
+				if (maxError > 0)
+					reconstructed[i] = Reconstruct(prediction, residual, maxError, step, range);
+
+				uint32_t zigzag = residual >= 0 ? 2 * residual : -2 * residual - 1;
+				uint32_t token = BitLength(zigzag);
+				if (token > 1)
+					bits.Put(zigzag - (1u << (token - 1)), token - 1);
+
+				tokens[i] = token;
+				contexts[i] = n.Context(step);
+				counts[contexts[i]][token]++;
+			}
+		}
+		bits.Flush();
+
+		uint16_t freqs[ContextCount][TokenCount];
+		uint16_t starts[ContextCount][TokenCount];
+		for (uint32_t c = 0; c < ContextCount; c++)
+		{
+			NormalizeFrequencies(counts[c], freqs[c]);
+			for (uint32_t s = 0, start = 0; s < TokenCount; s++)
+			{
+				starts[c][s] = start;
+				start += freqs[c][s];
+			}
+		}
+
+		// rANS is last in first out: encode backwards from the end of the buffer
+		std::vector<uint8_t> rans(nElements * 2 + 16);
+		uint8_t* ptr = rans.data() + rans.size();
+		uint32_t state = RansLowerBound;
+
+		for (uint32_t i = nElements; i-- > 0;)
+		{
+			uint32_t freq = freqs[contexts[i]][tokens[i]];
+			uint32_t maxState = ((RansLowerBound >> ProbabilityBits) << 8) * freq;
+			while (state >= maxState)
+			{
+				*--ptr = (uint8_t)state;
+				state >>= 8;
+			}
+			state = ((state / freq) << ProbabilityBits) + (state % freq) + starts[contexts[i]][tokens[i]];
+		}
+		ptr -= 4;
+		WriteLE(ptr, state, 4);
+		uint32_t ransSize = (uint32_t)(rans.data() + rans.size() - ptr);
+
+		dest.resize(HeaderSize + TablesSize + 4 + ransSize + extraBits.size());
+		uint8_t* out = dest.data();
+
+		memcpy(out, "dsd1", 4);
+		WriteLE(out + 4, width, 4);
+		WriteLE(out + 8, height, 4);
+		WriteLE(out + 12, maxError, 2);
+		out += HeaderSize;
+
+		for (uint32_t c = 0; c < ContextCount; c++)
+			for (uint32_t s = 0; s < TokenCount; s++, out += 2)
+				WriteLE(out, freqs[c][s], 2);
+
+		WriteLE(out, ransSize, 4);
+		memcpy(out + 4, ptr, ransSize);
+		memcpy(out + 4 + ransSize, extraBits.data(), extraBits.size());
+	}
+
+	bool DepthCodec::Decode(const uint8_t* source, size_t size, uint16_t* dest, uint32_t& width, uint32_t& height)
+	{
+		uint16_t maxError;
+		if (!ReadHeader(source, size, width, height, maxError))
+			return false;
+
+		const uint8_t* end = source + size;
+		const uint8_t* data = source + HeaderSize;
+		int step = 2 * maxError + 1;
+		int range = (65535 + 2 * maxError) / step + 1;
+
+		// Frequencies, starts and the slot -> token table of every context
+		uint16_t freqs[ContextCount][TokenCount];
+		uint16_t starts[ContextCount][TokenCount];
+		std::vector<uint8_t> slots(ContextCount * ProbabilityScale, 0);
+
+		for (uint32_t c = 0; c < ContextCount; c++)
+		{
+			uint32_t start = 0;
+			for (uint32_t s = 0; s < TokenCount; s++, data += 2)
+			{
+				freqs[c][s] = ReadLE(data, 2);
+				starts[c][s] = start;
+				if (start + freqs[c][s] > ProbabilityScale)
+					return false;
+
+				memset(slots.data() + c * ProbabilityScale + start, s, freqs[c][s]);
+				start += freqs[c][s];
+			}
+		}
+
+		uint32_t ransSize = ReadLE(data, 4);
+		data += 4;
+		if (ransSize < 4 || ransSize > (size_t)(end - data))
+			return false;
+
+		const uint8_t* ransEnd = data + ransSize;
+		uint32_t state = ReadLE(data, 4);
+		data += 4;
+		BitReader bits(ransEnd, end);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				Neighbours n(dest, x, y, width);
+				uint32_t c = n.Context(step);
+
+				uint32_t slot = state & (ProbabilityScale - 1);
+				uint32_t token = slots[c * ProbabilityScale + slot];
+				if (freqs[c][token] == 0)
+					return false;
+
+				state = freqs[c][token] * (state >> ProbabilityBits) + slot - starts[c][token];
+				while (state < RansLowerBound)
+					state = (state << 8) | (data < ransEnd ? *data++ : 0);
+
+				uint32_t zigzag = token > 1 ? (1u << (token - 1)) + bits.Get(token - 1) : token;
+				int residual = (zigzag & 1) ? -(int)((zigzag + 1) >> 1) : (int)(zigzag >> 1);
+				dest[(size_t)y * width + x] = Reconstruct(n.Predict(), residual, maxError, step, range);
+			}
+		}
+
+		return true;
+	}
+}
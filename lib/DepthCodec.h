@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DStream
+{
+	// Direct 16 bit depth codec, used as a baseline for the colour coders. Values are predicted with the MED
+	// predictor of LOCO-I and the residuals are split in a token (their bit length) and raw extra bits. Tokens are
+	// entropy coded with a static rANS coder, using a different frequency table depending on the local gradient.
+	// With maxError > 0 residuals are quantized JPEG-LS style, so every decoded value is within maxError of the
+	// original one.
+	class DepthCodec
+	{
+	public:
+		static void Encode(const uint16_t* source, uint32_t width, uint32_t height, std::vector<uint8_t>& dest, uint16_t maxError = 0);
+		// dest must hold width * height values
+		static bool Decode(const uint8_t* source, size_t size, uint16_t* dest, uint32_t& width, uint32_t& height);
+		static bool ReadHeader(const uint8_t* source, size_t size, uint32_t& width, uint32_t& height, uint16_t& maxError);
+
+		static const uint32_t HeaderSize = 14;
+		static const uint32_t ContextCount = 16;
+		static const uint32_t TokenCount = 17;
+		static const uint32_t ProbabilityBits = 12;
+	};
+}
@@ -0,0 +1,142 @@
+#include <DepthMask.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace DStream
+{
+	static inline void WriteVarint(std::vector<uint8_t>& dest, uint32_t v)
+	{
+		while (v >= 0x80)
+		{
+			dest.push_back((uint8_t)(v | 0x80));
+			v >>= 7;
+		}
+		dest.push_back((uint8_t)v);
+	}
+
+	static inline bool ReadVarint(const uint8_t*& source, const uint8_t* end, uint32_t& v)
+	{
+		v = 0;
+		for (uint32_t shift = 0; shift < 35 && source < end; shift += 7)
+		{
+			uint8_t byte = *source++;
+			v |= (uint32_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// Adds the interpolated value of every no-data element of a line to sums, lines without valid values add nothing
+	static void InterpolateLine(const uint16_t* data, const uint8_t* mask, uint32_t n, size_t step, uint32_t* sums, uint8_t* counts)
+	{
+		int64_t prev = -1;
+		for (uint32_t i = 0; i <= n; i++)
+		{
+			if (i < n && !mask[i * step])
+				continue;
+			if (i == n && prev < 0)
+				return;
+
+			// Gap between prev and i, either side can be missing at the borders
+			uint32_t start = (uint32_t)(prev + 1);
+			uint32_t left = prev >= 0 ? data[prev * step] : data[i * step];
+			uint32_t right = i < n ? data[i * step] : left;
+			uint32_t length = i - start + 1;
+			for (uint32_t j = start; j < i; j++)
+			{
+				sums[j * step] += left + ((int64_t)right - left) * (int64_t)(j - start + 1) / length;
+				counts[j * step]++;
+			}
+			prev = i;
+		}
+	}
+
+	uint32_t DepthMask::Build(uint8_t* mask, const float* depth, uint32_t nElements)
+	{
+		uint32_t nValid = 0;
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			mask[i] = std::isfinite(depth[i]);
+			nValid += mask[i];
+		}
+		return nValid;
+	}
+
+	void DepthMask::Fill(uint16_t* data, const uint8_t* mask, uint32_t width, uint32_t height)
+	{
+		size_t nElements = (size_t)width * height;
+		std::vector<uint32_t> sums(nElements, 0);
+		std::vector<uint8_t> counts(nElements, 0);
+
+		for (uint32_t y = 0; y < height; y++)
+			InterpolateLine(data + (size_t)y * width, mask + (size_t)y * width, width, 1, sums.data() + (size_t)y * width,
+				counts.data() + (size_t)y * width);
+		for (uint32_t x = 0; x < width; x++)
+			InterpolateLine(data + x, mask + x, height, width, sums.data() + x, counts.data() + x);
+
+		// Holes crossing a row and a column without valid values take the average of the frame
+		uint64_t validSum = 0, nValid = 0;
+		for (size_t i = 0; i < nElements; i++)
+		{
+			if (mask[i])
+			{
+				validSum += data[i];
+				nValid++;
+			}
+		}
+		uint16_t average = nValid ? (uint16_t)(validSum / nValid) : 0;
+
+		for (size_t i = 0; i < nElements; i++)
+			if (!mask[i])
+				data[i] = counts[i] ? (uint16_t)((sums[i] + counts[i] / 2) / counts[i]) : average;
+	}
+
+	void DepthMask::Apply(uint16_t* data, const uint8_t* mask, uint32_t nElements)
+	{
+		for (uint32_t i = 0; i < nElements; i++)
+			data[i] = mask[i] ? std::max<uint16_t>(data[i], 1) : 0;
+	}
+
+	void DepthMask::Write(const uint8_t* mask, uint32_t nElements, std::vector<uint8_t>& dest)
+	{
+		dest.resize(HeaderSize);
+		memcpy(dest.data(), "dstm", 4);
+		for (uint32_t i = 0; i < 4; i++)
+			dest[4 + i] = nElements >> (i * 8);
+
+		bool valid = true;
+		for (uint32_t i = 0; i < nElements;)
+		{
+			uint32_t start = i;
+			while (i < nElements && (mask[i] != 0) == valid)
+				i++;
+			WriteVarint(dest, i - start);
+			valid = !valid;
+		}
+	}
+
+	size_t DepthMask::Read(const uint8_t* source, size_t size, uint8_t* mask, uint32_t nElements)
+	{
+		if (size < HeaderSize || memcmp(source, "dstm", 4) != 0)
+			return 0;
+		uint32_t count = source[4] | (source[5] << 8) | (source[6] << 16) | ((uint32_t)source[7] << 24);
+		if (count != nElements)
+			return 0;
+
+		const uint8_t* data = source + HeaderSize;
+		const uint8_t* end = source + size;
+		bool valid = true;
+		for (uint32_t i = 0; i < nElements; valid = !valid)
+		{
+			uint32_t run;
+			if (!ReadVarint(data, end, run) || run > nElements - i)
+				return 0;
+			memset(mask + i, valid, run);
+			i += run;
+		}
+		return data - source;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DStream
+{
+	// Validity mask of a depth map, one byte per value: 0 marks no-data, anything else a valid depth. No-data values
+	// are not quantized as real depths, they are filled with values that compress cheaply before coding and the mask
+	// travels next to the encoded image as alternating runs of valid and no-data values. Serialized as "dstm", number
+	// of values (little endian uint32), then the run lengths as LEB128 varints, starting with a valid run
+	class DepthMask
+	{
+	public:
+		// Non finite depths are no-data, returns the number of valid values
+		static uint32_t Build(uint8_t* mask, const float* depth, uint32_t nElements);
+		// Replaces no-data values with the average of their horizontal and vertical linear interpolation between the
+		// closest valid values, extended past the borders, so that holes don't create edges for the image codec
+		static void Fill(uint16_t* data, const uint8_t* mask, uint32_t width, uint32_t height);
+		// Sets no-data values to 0 after decoding. Valid values were quantized to [1, 65535] (see DepthProcessing::Quantize),
+		// the ones that lossy coding took down to 0 are set to 1, so 0 only ever marks no-data
+		static void Apply(uint16_t* data, const uint8_t* mask, uint32_t nElements);
+
+		static void Write(const uint8_t* mask, uint32_t nElements, std::vector<uint8_t>& dest);
+		// Returns the number of bytes read, 0 on error or if the mask doesn't have nElements values
+		static size_t Read(const uint8_t* source, size_t size, uint8_t* mask, uint32_t nElements);
+
+		static const uint32_t HeaderSize = 8;
+	};
+}
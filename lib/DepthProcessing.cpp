@@ -1,12 +1,24 @@
 #include <DepthProcessing.h>
+#include <Simd.h>
 
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include <iostream>
 
 namespace DStream
 {
+#ifdef DSTREAM_X86
+    DSTREAM_TARGET("avx,f16c") static uint32_t ToHalfF16C(Half* dest, const float* source, uint32_t nElements)
+    {
+        uint32_t i = 0;
+        for (; i + 8 <= nElements; i += 8)
+            _mm_storeu_si128((__m128i*)(dest + i), _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+        return i;
+    }
+#endif
+
     static void GetMinMax(uint16_t& min, uint16_t& max, uint16_t* data, uint32_t nElements)
     {
         for (uint32_t i = 0; i < nElements; i++)
@@ -49,46 +61,193 @@ namespace DStream
         }
 	}
 
-    void DepthProcessing::Quantize(uint16_t* dest, float* source, uint8_t q, uint32_t nElements, float minHint, float maxHint)
+    void DepthProcessing::RemoveSpikes(uint16_t* data, uint32_t width, uint32_t height, uint32_t threshold)
     {
-        float min, max;
-        if (minHint < maxHint)
+        std::vector<uint16_t> source(data, data + (size_t)width * height);
+
+        for (uint32_t y = 0; y < height; y++)
         {
-            min = minHint;
-            max = maxHint;
+            uint32_t y0 = y > 0 ? y - 1 : 0, y1 = std::min(height - 1, y + 1);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t x0 = x > 0 ? x - 1 : 0, x1 = std::min(width - 1, x + 1);
+                uint16_t neighbours[8];
+                uint32_t count = 0, min = 65535, max = 0;
+
+                for (uint32_t ny = y0; ny <= y1; ny++)
+                {
+                    for (uint32_t nx = x0; nx <= x1; nx++)
+                    {
+                        if (nx == x && ny == y)
+                            continue;
+                        uint16_t v = source[(size_t)ny * width + nx];
+                        neighbours[count++] = v;
+                        min = std::min<uint32_t>(min, v);
+                        max = std::max<uint32_t>(max, v);
+                    }
+                }
+
+                uint32_t current = source[(size_t)y * width + x];
+                if (count == 0 || (current + threshold >= min && current <= max + threshold))
+                    continue;
+
+                std::nth_element(neighbours, neighbours + count / 2, neighbours + count);
+                data[(size_t)y * width + x] = neighbours[count / 2];
+            }
         }
-        else
-        {
-            min = std::numeric_limits<float>().max();
-            max = std::numeric_limits<float>().min();
+    }
 
-            for (uint32_t i = 0; i < nElements; i++)
+    // Ignores non finite values, min > max if there are none
+    static void GetMinMax(float& min, float& max, const float* data, uint32_t width, uint32_t height, uint32_t stride)
+    {
+        min = std::numeric_limits<float>::max();
+        max = std::numeric_limits<float>::lowest();
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* row = data + (size_t)y * stride;
+            for (uint32_t x = 0; x < width; x++)
             {
-                min = std::min(min, source[i]);
-                max = std::max(max, source[i]);
+                if (!std::isfinite(row[x]))
+                    continue;
+                min = std::min(min, row[x]);
+                max = std::max(max, row[x]);
             }
         }
+    }
 
-        for (uint32_t i = 0; i < nElements; i++)
-            dest[i] = std::round(((source[i] - min) / max) * ((1 << q)-1));
+    // Finite values go to [first, 2^q - 1], the others to 0
+    static void QuantizeRect(uint16_t* dest, const float* source, uint32_t width, uint32_t height, uint32_t stride, float min, float max,
+        uint8_t q, DepthRange& range, uint16_t first = 0)
+    {
+        float levels = (float)((1 << q) - 1 - first);
+        float scale = max > min ? levels / (max - min) : 0;
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* src = source + (size_t)y * stride;
+            uint16_t* dst = dest + (size_t)y * stride;
+            for (uint32_t x = 0; x < width; x++)
+                dst[x] = std::isfinite(src[x]) ? first + (uint16_t)std::round(std::clamp((src[x] - min) * scale, 0.0f, levels)) : 0;
+        }
+
+        range.Scale = max > min ? (max - min) / levels : 0;
+        range.Offset = (min <= max ? min : 0) - first * range.Scale;
+    }
+
+    DepthRange DepthProcessing::Quantize(uint16_t* dest, float* source, uint8_t q, uint32_t nElements, float minHint, float maxHint,
+        bool reserveNoData)
+    {
+        float min = minHint, max = maxHint;
+        if (!(minHint < maxHint))
+            GetMinMax(min, max, source, nElements, 1, nElements);
+
+        DepthRange range;
+        QuantizeRect(dest, source, nElements, 1, nElements, min, max, q, range, reserveNoData ? 1 : 0);
+        return range;
     }
 
     void DepthProcessing::Quantize(uint16_t* dest, uint16_t* source, uint8_t q, uint32_t nElements, uint16_t minHint, uint16_t maxHint)
     {
-        uint16_t min = 65535, max = 0;
-        GetMinMax(min, max, source, nElements);
+        uint16_t min = minHint, max = maxHint;
+        if (!(minHint < maxHint))
+        {
+            min = 65535;
+            max = 0;
+            GetMinMax(min, max, source, nElements);
+        }
 
+        float scale = max > min ? ((1 << q) - 1) / (float)(max - min) : 0;
         for (uint32_t i = 0; i < nElements; i++)
-            dest[i] = std::round(((float)(source[i] - min) / max) * ((1 << q)-1));
+            dest[i] = std::round(std::clamp(source[i] - min, 0, max - min) * scale);
     }
 
+    void DepthProcessing::QuantizeTiled(uint16_t* dest, const float* source, uint32_t width, uint32_t height, uint32_t tileSize, uint8_t q,
+        std::vector<DepthRange>& ranges, bool reserveNoData)
+    {
+        uint32_t tilesX = (width + tileSize - 1) / tileSize, tilesY = (height + tileSize - 1) / tileSize;
+        ranges.resize(tilesX * tilesY);
 
-    void DepthProcessing::Dequantize(uint16_t* dest, uint16_t* source, uint8_t currQ, uint32_t nElements, uint16_t minHint, uint16_t maxHint)
+        for (uint32_t ty = 0; ty < tilesY; ty++)
+        {
+            for (uint32_t tx = 0; tx < tilesX; tx++)
+            {
+                uint32_t x = tx * tileSize, y = ty * tileSize;
+                uint32_t w = std::min(tileSize, width - x), h = std::min(tileSize, height - y);
+                size_t offset = (size_t)y * width + x;
+
+                float min, max;
+                GetMinMax(min, max, source + offset, w, h, width);
+                QuantizeRect(dest + offset, source + offset, w, h, width, min, max, q, ranges[ty * tilesX + tx], reserveNoData ? 1 : 0);
+            }
+        }
+    }
+
+    void DepthProcessing::DequantizeTiled(float* dest, const uint16_t* source, uint32_t width, uint32_t height, uint32_t tileSize,
+        const std::vector<DepthRange>& ranges)
     {
-        uint16_t min = 65535, max = 0;
-        GetMinMax(min, max, source, nElements);
+        uint32_t tilesX = (width + tileSize - 1) / tileSize;
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const DepthRange* rowRanges = ranges.data() + (y / tileSize) * tilesX;
+            const uint16_t* src = source + (size_t)y * width;
+            float* dst = dest + (size_t)y * width;
 
+            for (uint32_t x = 0, tx = 0; x < width; x += tileSize, tx++)
+            {
+                float offset = rowRanges[tx].Offset, scale = rowRanges[tx].Scale;
+                uint32_t end = std::min(width, x + tileSize);
+                for (uint32_t i = x; i < end; i++)
+                    dst[i] = offset + src[i] * scale;
+            }
+        }
+    }
+
+
+    void DepthProcessing::Dequantize(uint16_t* dest, uint16_t* source, uint8_t currQ, uint32_t nElements, uint16_t minHint, uint16_t maxHint)
+    {
         for (uint32_t i = 0; i < nElements; i++)
             dest[i] = source[i] << (16 - currQ);
     }
+
+    void DepthProcessing::Dequantize(float* dest, const uint16_t* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask,
+        float noData)
+    {
+        float offset = range.Offset, scale = range.Scale;
+        if (mask)
+        {
+            for (uint32_t i = 0; i < nElements; i++)
+                dest[i] = mask[i] ? offset + source[i] * scale : noData;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < nElements; i++)
+                dest[i] = offset + source[i] * scale;
+        }
+    }
+
+    void DepthProcessing::Dequantize(Half* dest, const uint16_t* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask,
+        float noData)
+    {
+        const uint32_t batchSize = 256;
+        float depth[batchSize];
+#ifdef DSTREAM_X86
+        bool f16c = CpuFeatures::Get().F16C;
+#endif
+
+        for (uint32_t start = 0; start < nElements; start += batchSize)
+        {
+            uint32_t count = std::min(batchSize, nElements - start);
+            Dequantize(depth, source + start, count, range, mask ? mask + start : nullptr, noData);
+
+            uint32_t i = 0;
+#ifdef DSTREAM_X86
+            if (f16c)
+                i = ToHalfF16C(dest + start, depth, count);
+#endif
+            for (; i < count; i++)
+                dest[start + i] = Half::FromFloat(depth[i]);
+        }
+    }
 }
\ No newline at end of file
@@ -1,16 +1,53 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <DataStructs/Half.h>
 
 namespace DStream
 {
+	// Maps quantized values back to depth: depth = Offset + value * Scale
+	struct DepthRange
+	{
+		float Offset = 0;
+		float Scale = 1;
+	};
+
 	class DepthProcessing
 	{
 	public:
+		// Distance outside the range of its neighbours above which a value of a reduced resolution preview is a spike
+		static constexpr uint32_t PreviewSpikeThreshold = 1024;
+
 		static void DenoiseMedian(uint16_t* source, uint32_t width, uint32_t height, uint32_t threshold, int halfWindow = 1);
+		// Replaces values further than threshold outside the range of their 8 neighbours with the median of the neighbours.
+		// Unlike DenoiseMedian, values between their neighbours, like the averages on the edges of a downscaled depth map,
+		// are kept
+		static void RemoveSpikes(uint16_t* data, uint32_t width, uint32_t height, uint32_t threshold = PreviewSpikeThreshold);
 
-		static void Quantize(uint16_t* dest, float* source, uint8_t q, uint32_t nElements, float minHint = 1, float maxHint = 0);
+		// Values are normalized between min and max (the hints if minHint < maxHint, the data range otherwise) and
+		// mapped to [0, 2^q - 1]. The float version returns the range to dequantize them. With reserveNoData valid values
+		// are mapped to [1, 2^q - 1] and non finite ones to 0, so that decoded no-data can't be mistaken for the minimum
+		static DepthRange Quantize(uint16_t* dest, float* source, uint8_t q, uint32_t nElements, float minHint = 1, float maxHint = 0,
+			bool reserveNoData = false);
 		static void Quantize(uint16_t* dest, uint16_t* source, uint8_t q, uint32_t nElements, uint16_t minHint = 1, uint16_t maxHint = 0);
 		static void Dequantize(uint16_t* dest, uint16_t* source, uint8_t currQ, uint32_t nElements, uint16_t minHint = 1, uint16_t maxHint = 0);
+		// depth = range.Offset + value * range.Scale, values whose mask byte is 0 become noData
+		static void Dequantize(float* dest, const uint16_t* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask = nullptr,
+			float noData = std::numeric_limits<float>::quiet_NaN());
+		static void Dequantize(Half* dest, const uint16_t* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask = nullptr,
+			float noData = std::numeric_limits<float>::quiet_NaN());
+
+		// Every tileSize x tileSize tile (smaller on the right and bottom borders) is quantized to the range of its own
+		// values, so a tile spanning a few metres in a scene spanning kilometres still uses all the 2^q levels.
+		// ranges receives one entry per tile in row major order. Non finite values are quantized to 0, reserveNoData works
+		// as in Quantize
+		static void QuantizeTiled(uint16_t* dest, const float* source, uint32_t width, uint32_t height, uint32_t tileSize, uint8_t q,
+			std::vector<DepthRange>& ranges, bool reserveNoData = false);
+		// Goes from quantized values to depth in a single pass, with the range of the tile of each value
+		static void DequantizeTiled(float* dest, const uint16_t* source, uint32_t width, uint32_t height, uint32_t tileSize,
+			const std::vector<DepthRange>& ranges);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <HugePages.h>
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#elif defined(__linux__)
+	#include <sys/mman.h>
+#endif
+
+namespace DStream
+{
+	static const size_t HugePageSize = 2 * 1024 * 1024;
+
+	static size_t RoundToPages(size_t size, size_t pageSize)
+	{
+		return (size + pageSize - 1) & ~(pageSize - 1);
+	}
+
+	void* HugePages::Allocate(size_t size)
+	{
+#if defined(_WIN32)
+		SIZE_T largePageSize = GetLargePageMinimum();
+		if (largePageSize != 0)
+		{
+			// Only succeeds if the process holds SeLockMemoryPrivilege
+			void* ptr = VirtualAlloc(NULL, RoundToPages(size, largePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (ptr != NULL)
+				return ptr;
+		}
+		return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(__linux__)
+		size_t allocSize = RoundToPages(size, HugePageSize);
+
+		void* ptr = mmap(NULL, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+			return ptr;
+
+		// No reserved huge pages: over-allocate so that the block can be aligned to 2MB, then trim the excess
+		uint8_t* raw = (uint8_t*)mmap(NULL, allocSize + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED)
+			return nullptr;
+
+		uint8_t* aligned = (uint8_t*)RoundToPages((size_t)raw, HugePageSize);
+		if (aligned != raw)
+			munmap(raw, aligned - raw);
+		if (aligned + allocSize != raw + allocSize + HugePageSize)
+			munmap(aligned + allocSize, (raw + allocSize + HugePageSize) - (aligned + allocSize));
+	#ifdef MADV_HUGEPAGE
+		madvise(aligned, allocSize, MADV_HUGEPAGE);
+	#endif
+		return aligned;
+#else
+		return malloc(size);
+#endif
+	}
+
+	void HugePages::Free(void* ptr, size_t size)
+	{
+		if (ptr == nullptr)
+			return;
+#if defined(_WIN32)
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(__linux__)
+		munmap(ptr, RoundToPages(size, HugePageSize));
+#else
+		free(ptr);
+#endif
+	}
+}
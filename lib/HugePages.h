@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+namespace DStream
+{
+	// Allocations backed by 2MB pages when the system allows it. Explicit huge pages are tried first
+	// (MAP_HUGETLB / MEM_LARGE_PAGES), then the allocation falls back to regular pages, aligned to 2MB
+	// and marked with MADV_HUGEPAGE so that transparent huge pages can still be used.
+	class HugePages
+	{
+	public:
+		static void* Allocate(size_t size);
+		static void Free(void* ptr, size_t size);
+	};
+}
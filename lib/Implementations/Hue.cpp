@@ -1,4 +1,5 @@
 #include "Hue.h"
+#include <Simd.h>
 #include <math.h>
 
 namespace DStream
@@ -65,4 +66,297 @@ namespace DStream
         ret = (uint16_t)q;
         return ret;
     }
+
+    // Hue index of a value, std::round is replaced by an explicit half-away-from-zero so that the SIMD
+    // versions can do exactly the same
+    static inline int32_t HueIndex(uint16_t val)
+    {
+        float x = ((float)val / 65535.0f) * 1529.0f;
+        float t = std::trunc(x);
+        return (int32_t)t + (x - t >= 0.5f);
+    }
+
+    static inline uint16_t HueValue(int32_t index)
+    {
+        float x = ((float)index / 1529.0f) * 65535.0f;
+        float t = std::trunc(x);
+        return (uint16_t)((int32_t)t + (x - t >= 0.5f));
+    }
+
+    // Same piecewise function as EncodeValue, 8 bit wraps included
+    static inline Color HueColor(int32_t d)
+    {
+        int32_t r = 255 - d;
+        r = d > 511 ? 0 : r;
+        r = d > 1020 ? d - 1020 : r;
+        r = (d > 1275 || d <= 255) ? 255 : r;
+
+        int32_t g = d;
+        g = d > 255 ? 255 : g;
+        g = d > 765 ? 1020 - d : g;
+        g = d > 1020 ? 0 : g;
+
+        int32_t b = d > 511 ? d : 0;
+        b = d > 765 ? 255 : b;
+        b = d > 1275 ? 1275 - d : b;
+
+        return Color(r & 255, g & 255, b & 255);
+    }
+
+    static inline int32_t HueIndex(int32_t r, int32_t g, int32_t b)
+    {
+        int32_t redMax = g - b + (b > g ? 1529 : 0);
+        int32_t ret = r - g + 1020;
+        ret = (r > g || b > g) ? ret : b - r + 510;
+        ret = (g > r || b > r) ? ret : redMax;
+        return r + g + b < 255 ? 0 : ret;
+    }
+
+    const Color* Hue::GetPalette()
+    {
+        struct Palette
+        {
+            Color Colors[PaletteSize];
+            Palette() { for (uint32_t d = 0; d < PaletteSize; d++) Colors[d] = HueColor(d); }
+        };
+        static const Palette palette;
+        return palette.Colors;
+    }
+
+#ifdef DSTREAM_X86
+    // 16 interleaved RGB pixels <-> 3 planes of 16 bytes
+    DSTREAM_TARGET("sse4.1") static inline void StoreInterleaved(Color* dest, __m128i r, __m128i g, __m128i b)
+    {
+        const int8_t z = -128;
+        __m128i out0 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(r, _mm_setr_epi8(0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z, z, 5)),
+            _mm_shuffle_epi8(g, _mm_setr_epi8(z, 0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z, z))),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, 0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z)));
+        __m128i out1 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(r, _mm_setr_epi8(z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z, 10, z)),
+            _mm_shuffle_epi8(g, _mm_setr_epi8(5, z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z, 10))),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(z, 5, z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z)));
+        __m128i out2 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(r, _mm_setr_epi8(z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15, z, z)),
+            _mm_shuffle_epi8(g, _mm_setr_epi8(z, z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15, z))),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(10, z, z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15)));
+
+        __m128i* out = (__m128i*)dest;
+        _mm_storeu_si128(out, out0);
+        _mm_storeu_si128(out + 1, out1);
+        _mm_storeu_si128(out + 2, out2);
+    }
+
+    DSTREAM_TARGET("sse4.1") static inline void LoadInterleaved(const Color* source, __m128i& r, __m128i& g, __m128i& b)
+    {
+        const int8_t z = -128;
+        const __m128i* in = (const __m128i*)source;
+        __m128i in0 = _mm_loadu_si128(in), in1 = _mm_loadu_si128(in + 1), in2 = _mm_loadu_si128(in + 2);
+
+        r = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(in0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, z, z, z, z, z, z, z, z, z, z)),
+            _mm_shuffle_epi8(in1, _mm_setr_epi8(z, z, z, z, z, z, 2, 5, 8, 11, 14, z, z, z, z, z))),
+            _mm_shuffle_epi8(in2, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 1, 4, 7, 10, 13)));
+        g = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(in0, _mm_setr_epi8(1, 4, 7, 10, 13, z, z, z, z, z, z, z, z, z, z, z)),
+            _mm_shuffle_epi8(in1, _mm_setr_epi8(z, z, z, z, z, 0, 3, 6, 9, 12, 15, z, z, z, z, z))),
+            _mm_shuffle_epi8(in2, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 2, 5, 8, 11, 14)));
+        b = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(in0, _mm_setr_epi8(2, 5, 8, 11, 14, z, z, z, z, z, z, z, z, z, z, z)),
+            _mm_shuffle_epi8(in1, _mm_setr_epi8(z, z, z, z, z, 1, 4, 7, 10, 13, z, z, z, z, z, z))),
+            _mm_shuffle_epi8(in2, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, 0, 3, 6, 9, 12, 15)));
+    }
+
+    DSTREAM_TARGET("sse4.1") static inline __m128i RoundScaled(__m128i v, __m128 div, __m128 mul)
+    {
+        __m128 x = _mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(v), div), mul);
+        __m128 t = _mm_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m128 up = _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(x, t), _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(t, up));
+    }
+
+    DSTREAM_TARGET("sse4.1") static inline void HueColorSSE(__m128i d, __m128i& r, __m128i& g, __m128i& b)
+    {
+        const __m128i c255 = _mm_set1_epi16(255);
+        __m128i gt255 = _mm_cmpgt_epi16(d, c255);
+        __m128i gt511 = _mm_cmpgt_epi16(d, _mm_set1_epi16(511));
+        __m128i gt765 = _mm_cmpgt_epi16(d, _mm_set1_epi16(765));
+        __m128i gt1020 = _mm_cmpgt_epi16(d, _mm_set1_epi16(1020));
+        __m128i gt1275 = _mm_cmpgt_epi16(d, _mm_set1_epi16(1275));
+
+        r = _mm_andnot_si128(gt511, _mm_sub_epi16(c255, d));
+        r = _mm_blendv_epi8(r, _mm_sub_epi16(d, _mm_set1_epi16(1020)), gt1020);
+        r = _mm_blendv_epi8(c255, r, _mm_andnot_si128(gt1275, gt255));
+
+        g = _mm_blendv_epi8(d, c255, gt255);
+        g = _mm_blendv_epi8(g, _mm_sub_epi16(_mm_set1_epi16(1020), d), gt765);
+        g = _mm_andnot_si128(gt1020, g);
+
+        b = _mm_and_si128(gt511, d);
+        b = _mm_blendv_epi8(b, c255, gt765);
+        b = _mm_blendv_epi8(b, _mm_sub_epi16(_mm_set1_epi16(1275), d), gt1275);
+
+        r = _mm_and_si128(r, c255);
+        g = _mm_and_si128(g, c255);
+        b = _mm_and_si128(b, c255);
+    }
+
+    DSTREAM_TARGET("sse4.1") static inline __m128i HueIndexSSE(__m128i r, __m128i g, __m128i b)
+    {
+        __m128i redMax = _mm_add_epi16(_mm_sub_epi16(g, b), _mm_and_si128(_mm_cmpgt_epi16(b, g), _mm_set1_epi16(1529)));
+        __m128i ret = _mm_add_epi16(_mm_sub_epi16(r, g), _mm_set1_epi16(1020));
+        ret = _mm_blendv_epi8(_mm_add_epi16(_mm_sub_epi16(b, r), _mm_set1_epi16(510)), ret, _mm_or_si128(_mm_cmpgt_epi16(r, g), _mm_cmpgt_epi16(b, g)));
+        ret = _mm_blendv_epi8(redMax, ret, _mm_or_si128(_mm_cmpgt_epi16(g, r), _mm_cmpgt_epi16(b, r)));
+        __m128i dark = _mm_cmpgt_epi16(_mm_set1_epi16(255), _mm_add_epi16(_mm_add_epi16(r, g), b));
+        return _mm_andnot_si128(dark, ret);
+    }
+
+    DSTREAM_TARGET("sse4.1") static uint32_t EncodeSSE41(Color* dest, const uint16_t* source, uint32_t nElements)
+    {
+        const __m128 div = _mm_set1_ps(65535.0f), mul = _mm_set1_ps(1529.0f);
+        uint32_t i = 0;
+        for (; i + 16 <= nElements; i += 16)
+        {
+            __m128i r[2], g[2], b[2];
+            for (uint32_t k = 0; k < 2; k++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(source + i + k * 8));
+                __m128i lo = RoundScaled(_mm_cvtepu16_epi32(v), div, mul);
+                __m128i hi = RoundScaled(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)), div, mul);
+                HueColorSSE(_mm_packs_epi32(lo, hi), r[k], g[k], b[k]);
+            }
+            StoreInterleaved(dest + i, _mm_packus_epi16(r[0], r[1]), _mm_packus_epi16(g[0], g[1]), _mm_packus_epi16(b[0], b[1]));
+        }
+        return i;
+    }
+
+    DSTREAM_TARGET("sse4.1") static uint32_t DecodeSSE41(uint16_t* dest, const Color* source, uint32_t nElements)
+    {
+        const __m128 div = _mm_set1_ps(1529.0f), mul = _mm_set1_ps(65535.0f);
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t i = 0;
+        for (; i + 16 <= nElements; i += 16)
+        {
+            __m128i r, g, b;
+            LoadInterleaved(source + i, r, g, b);
+
+            __m128i index[2] = {
+                HueIndexSSE(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero)),
+                HueIndexSSE(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero))
+            };
+            for (uint32_t k = 0; k < 2; k++)
+            {
+                __m128i lo = RoundScaled(_mm_unpacklo_epi16(index[k], zero), div, mul);
+                __m128i hi = RoundScaled(_mm_unpackhi_epi16(index[k], zero), div, mul);
+                _mm_storeu_si128((__m128i*)(dest + i + k * 8), _mm_packus_epi32(lo, hi));
+            }
+        }
+        return i;
+    }
+
+    DSTREAM_TARGET("avx2") static inline __m256i RoundScaled(__m256i v, __m256 div, __m256 mul)
+    {
+        __m256 x = _mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(v), div), mul);
+        __m256 t = _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256 up = _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(x, t), _mm256_set1_ps(0.5f), _CMP_GE_OQ), _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(t, up));
+    }
+
+    DSTREAM_TARGET("avx2") static uint32_t EncodeAVX2(Color* dest, const uint16_t* source, uint32_t nElements)
+    {
+        const __m256 div = _mm256_set1_ps(65535.0f), mul = _mm256_set1_ps(1529.0f);
+        const __m256i c255 = _mm256_set1_epi16(255);
+        uint32_t i = 0;
+        for (; i + 16 <= nElements; i += 16)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(source + i));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(source + i + 8));
+            __m256i lo = RoundScaled(_mm256_cvtepu16_epi32(v0), div, mul);
+            __m256i hi = RoundScaled(_mm256_cvtepu16_epi32(v1), div, mul);
+            __m256i d = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+
+            __m256i gt255 = _mm256_cmpgt_epi16(d, c255);
+            __m256i gt511 = _mm256_cmpgt_epi16(d, _mm256_set1_epi16(511));
+            __m256i gt765 = _mm256_cmpgt_epi16(d, _mm256_set1_epi16(765));
+            __m256i gt1020 = _mm256_cmpgt_epi16(d, _mm256_set1_epi16(1020));
+            __m256i gt1275 = _mm256_cmpgt_epi16(d, _mm256_set1_epi16(1275));
+
+            __m256i r = _mm256_andnot_si256(gt511, _mm256_sub_epi16(c255, d));
+            r = _mm256_blendv_epi8(r, _mm256_sub_epi16(d, _mm256_set1_epi16(1020)), gt1020);
+            r = _mm256_blendv_epi8(c255, r, _mm256_andnot_si256(gt1275, gt255));
+
+            __m256i g = _mm256_blendv_epi8(d, c255, gt255);
+            g = _mm256_blendv_epi8(g, _mm256_sub_epi16(_mm256_set1_epi16(1020), d), gt765);
+            g = _mm256_andnot_si256(gt1020, g);
+
+            __m256i b = _mm256_and_si256(gt511, d);
+            b = _mm256_blendv_epi8(b, c255, gt765);
+            b = _mm256_blendv_epi8(b, _mm256_sub_epi16(_mm256_set1_epi16(1275), d), gt1275);
+
+            r = _mm256_and_si256(r, c255);
+            g = _mm256_and_si256(g, c255);
+            b = _mm256_and_si256(b, c255);
+
+            StoreInterleaved(dest + i,
+                _mm_packus_epi16(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)),
+                _mm_packus_epi16(_mm256_castsi256_si128(g), _mm256_extracti128_si256(g, 1)),
+                _mm_packus_epi16(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1)));
+        }
+        return i;
+    }
+
+    DSTREAM_TARGET("avx2") static uint32_t DecodeAVX2(uint16_t* dest, const Color* source, uint32_t nElements)
+    {
+        const __m256 div = _mm256_set1_ps(1529.0f), mul = _mm256_set1_ps(65535.0f);
+        uint32_t i = 0;
+        for (; i + 16 <= nElements; i += 16)
+        {
+            __m128i r8, g8, b8;
+            LoadInterleaved(source + i, r8, g8, b8);
+            __m256i r = _mm256_cvtepu8_epi16(r8), g = _mm256_cvtepu8_epi16(g8), b = _mm256_cvtepu8_epi16(b8);
+
+            __m256i redMax = _mm256_add_epi16(_mm256_sub_epi16(g, b), _mm256_and_si256(_mm256_cmpgt_epi16(b, g), _mm256_set1_epi16(1529)));
+            __m256i index = _mm256_add_epi16(_mm256_sub_epi16(r, g), _mm256_set1_epi16(1020));
+            index = _mm256_blendv_epi8(_mm256_add_epi16(_mm256_sub_epi16(b, r), _mm256_set1_epi16(510)), index,
+                _mm256_or_si256(_mm256_cmpgt_epi16(r, g), _mm256_cmpgt_epi16(b, g)));
+            index = _mm256_blendv_epi8(redMax, index, _mm256_or_si256(_mm256_cmpgt_epi16(g, r), _mm256_cmpgt_epi16(b, r)));
+            __m256i dark = _mm256_cmpgt_epi16(_mm256_set1_epi16(255), _mm256_add_epi16(_mm256_add_epi16(r, g), b));
+            index = _mm256_andnot_si256(dark, index);
+
+            __m256i lo = RoundScaled(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(index)), div, mul);
+            __m256i hi = RoundScaled(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1)), div, mul);
+            _mm256_storeu_si256((__m256i*)(dest + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8));
+        }
+        return i;
+    }
+#endif
+
+    void Hue::EncodeBatch(Color* dest, const uint16_t* source, uint32_t nElements)
+    {
+        uint32_t i = 0;
+#ifdef DSTREAM_X86
+        const CpuFeatures& cpu = CpuFeatures::Get();
+        if (cpu.AVX2)
+            i = EncodeAVX2(dest, source, nElements);
+        else if (cpu.SSE41)
+            i = EncodeSSE41(dest, source, nElements);
+#endif
+        const Color* palette = GetPalette();
+        for (; i < nElements; i++)
+            dest[i] = palette[HueIndex(source[i])];
+    }
+
+    void Hue::DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements)
+    {
+        uint32_t i = 0;
+#ifdef DSTREAM_X86
+        const CpuFeatures& cpu = CpuFeatures::Get();
+        if (cpu.AVX2)
+            i = DecodeAVX2(dest, source, nElements);
+        else if (cpu.SSE41)
+            i = DecodeSSE41(dest, source, nElements);
+#endif
+        for (; i < nElements; i++)
+            dest[i] = HueValue(HueIndex(source[i].x, source[i].y, source[i].z));
+    }
 }
@@ -14,5 +14,15 @@ namespace DStream
 
 		Color EncodeValue(uint16_t value);
 		uint16_t DecodeValue(Color value);
+
+		// Branch free EncodeValue / DecodeValue, vectorized with SSE4.1 or AVX2 if the CPU supports them.
+		// The results are the same as the scalar functions.
+		void EncodeBatch(Color* dest, const uint16_t* source, uint32_t nElements);
+		void DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements);
+
+		// The encoded colour only depends on the hue index in [0, 1529]: 1530 colours, 4.5KB, fit in L1
+		// where the 65536 entries of a full encoding table don't
+		static const Color* GetPalette();
+		static const uint32_t PaletteSize = 1530;
 	};
 }
\ No newline at end of file
@@ -2,9 +2,37 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
 
 namespace DStream
 {
+	// acos(2 * x / 255 - 1) * P / (2 * PI) for every possible first channel value, 24.8 fixed point.
+	// Precomputed so that decoding doesn't depend on the platform's acos.
+	static const int32_t PhaseLut[256] = {
+		2097152, 2013491, 1978759, 1952056, 1929499, 1909586, 1891547, 1874925, 1859423, 1844833, 1831006, 1817827,
+		1805210, 1793083, 1781390, 1770084, 1759126, 1748484, 1738128, 1728035, 1718184, 1708555, 1699133, 1689903,
+		1680852, 1671969, 1663242, 1654663, 1646223, 1637915, 1629730, 1621662, 1613706, 1605856, 1598106, 1590453,
+		1582890, 1575415, 1568023, 1560712, 1553476, 1546314, 1539222, 1532198, 1525238, 1518341, 1511503, 1504724,
+		1498000, 1491329, 1484710, 1478141, 1471621, 1465146, 1458717, 1452331, 1445987, 1439683, 1433419, 1427193,
+		1421004, 1414850, 1408730, 1402644, 1396591, 1390569, 1384577, 1378615, 1372681, 1366775, 1360896, 1355042,
+		1349215, 1343411, 1337631, 1331875, 1326141, 1320428, 1314736, 1309065, 1303414, 1297782, 1292168, 1286572,
+		1280994, 1275432, 1269887, 1264358, 1258844, 1253344, 1247859, 1242388, 1236931, 1231486, 1226053, 1220633,
+		1215224, 1209827, 1204440, 1199063, 1193697, 1188339, 1182991, 1177652, 1172321, 1166998, 1161683, 1156375,
+		1151073, 1145778, 1140490, 1135207, 1129930, 1124657, 1119390, 1114127, 1108868, 1103613, 1098361, 1093112,
+		1087866, 1082622, 1077381, 1072141, 1066903, 1061666, 1056430, 1051194, 1045958, 1040722, 1035486, 1030249,
+		1025011, 1019771, 1014530, 1009286, 1004040, 998791, 993539, 988284, 983025, 977762, 972495, 967222,
+		961945, 956662, 951374, 946079, 940777, 935469, 930154, 924831, 919500, 914161, 908813, 903455,
+		898089, 892712, 887325, 881928, 876519, 871099, 865666, 860221, 854764, 849293, 843808, 838308,
+		832794, 827265, 821720, 816158, 810580, 804984, 799370, 793738, 788087, 782416, 776724, 771011,
+		765277, 759521, 753741, 747937, 742110, 736256, 730377, 724471, 718537, 712575, 706583, 700561,
+		694508, 688422, 682302, 676148, 669959, 663733, 657469, 651165, 644821, 638435, 632006, 625531,
+		619011, 612442, 605823, 599152, 592428, 585649, 578811, 571914, 564954, 557930, 550838, 543676,
+		536440, 529129, 521737, 514262, 506699, 499046, 491296, 483446, 475490, 467422, 459237, 450929,
+		442489, 433910, 425183, 416300, 407249, 398019, 388597, 378968, 369117, 359024, 348668, 338026,
+		327068, 315762, 304069, 291942, 279325, 266146, 252319, 237729, 222227, 205605, 187566, 167653,
+		145096, 118393, 83661, 0
+	};
+
 	Phase::Phase(uint8_t algoBits, std::vector<uint8_t> channelDistribution)
 		: Coder(algoBits, channelDistribution) {}
 
@@ -41,4 +69,24 @@ namespace DStream
 		Z = PHI * (P / (M_PI * 2.0f));
 		return std::min(std::max(0, static_cast<int>(Z)), 1 << 16);
 	}
-}
\ No newline at end of file
+
+	void Phase::DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements)
+	{
+		const int32_t P = 1 << 14;
+
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			int32_t i1 = source[i].x, i2 = source[i].y;
+
+			// gamma = floor(i2 * 8 / 255), K = round(i2 * 4 / 255)
+			int32_t gammaOdd = ((i2 * 8) / 255) & 1;
+			int32_t K = (i2 * 8 + 255) / 510;
+			int32_t phi = PhaseLut[i1];
+
+			// Negate phi if gamma is odd
+			phi = (phi ^ -gammaOdd) + gammaOdd;
+			int32_t Z = (phi + ((K * P) << 8)) >> 8;
+			dest[i] = (uint16_t)std::min(std::max(Z, 0), 65535);
+		}
+	}
+}
@@ -11,8 +11,12 @@ namespace DStream
 		Phase(uint8_t algoBits, std::vector<uint8_t> channelDistribution);
 
 		inline bool SupportsInterpolation() override { return false; }
+		// The phase is periodic, the second channel is the linear ramp that disambiguates it
+		inline uint8_t GetCoarseChannel() override { return 1; }
 
 		Color EncodeValue(uint16_t value);
 		uint16_t DecodeValue(Color value);
+		// Fixed point DecodeValue: branch free, bit exact on every platform and within 1 of the floating point one
+		void DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements);
 	};
 }
\ No newline at end of file
@@ -1,8 +1,33 @@
 #include "Triangle.h"
 #include <math.h>
+#include <algorithm>
 
 namespace DStream
 {
+    // Everything the decoder needs from the first channel. With p = 1/128 and Ld = x / 255:
+    //  m = floor(512x / 255 - 0.5) % 4 selects which of Ha, Hb, 1-Ha, 1-Hb refines the value
+    //  L0 = (4 * trunc(128x / 255 - 1/8) + m) / 512 is the start of the segment
+    // so that the decoded value is round((L0 + (p/2) * H) * 65535) = (Base + 514 * H) >> 9
+    struct TriangleSegments
+    {
+        int32_t Base[256];
+        int32_t Mode[256];
+
+        TriangleSegments()
+        {
+            for (int32_t x = 0; x < 256; x++)
+            {
+                int32_t m = x == 0 ? 0 : ((1024 * x - 255) / 510) % 4;
+                int32_t s = x == 0 ? 0 : (1024 * x - 255) / 2040;
+
+                Base[x] = 65535 * (4 * s + m) + 256;
+                Mode[x] = m;
+            }
+        }
+    };
+
+    static const TriangleSegments Segments;
+
 	Triangle::Triangle(uint8_t algoBits, std::vector<uint8_t> channelDistribution) : Coder(algoBits, channelDistribution) {}
 
 	Color Triangle::EncodeValue(uint16_t val)
@@ -56,4 +81,20 @@ namespace DStream
 
         return std::round((L0 + delta) * maxVal);
 	}
+
+    void Triangle::DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements)
+    {
+        for (uint32_t i = 0; i < nElements; i++)
+        {
+            int32_t m = Segments.Mode[source[i].x];
+            int32_t ha = source[i].y, hb = source[i].z;
+
+            // Modes 1 and 3 use Hb, modes 2 and 3 use the complement
+            int32_t h = ha ^ ((ha ^ hb) & -(m & 1));
+            h ^= -(m >> 1) & 255;
+
+            int32_t val = (Segments.Base[source[i].x] + 514 * h) >> 9;
+            dest[i] = (uint16_t)std::min(val, 65535);
+        }
+    }
 }
@@ -14,6 +14,8 @@ namespace DStream
 
 		Color EncodeValue(uint16_t value);
 		uint16_t DecodeValue(Color value);
+		// Integer DecodeValue: branch free, bit exact on every platform and within 1 of the floating point one
+		void DecodeBatch(uint16_t* dest, const Color* source, uint32_t nElements);
 
 	};
 }
\ No newline at end of file
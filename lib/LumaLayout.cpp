@@ -0,0 +1,71 @@
+#include <LumaLayout.h>
+
+namespace DStream
+{
+	std::array<uint8_t, 3> LumaLayout::GetOrder(uint8_t coarseChannel)
+	{
+		std::array<uint8_t, 3> order = { coarseChannel, 0, 0 };
+		for (uint8_t c = 0, k = 1; c < 3; c++)
+			if (c != coarseChannel)
+				order[k++] = c;
+		return order;
+	}
+
+	void LumaLayout::Apply(Color* dest, const Color* source, uint32_t nElements, uint8_t coarseChannel)
+	{
+		std::array<uint8_t, 3> order = GetOrder(coarseChannel);
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			Color col = source[i];
+			dest[i] = Color(col[order[0]], col[order[1]], col[order[2]]);
+		}
+	}
+
+	void LumaLayout::Revert(Color* dest, const Color* source, uint32_t nElements, uint8_t coarseChannel)
+	{
+		std::array<uint8_t, 3> order = GetOrder(coarseChannel);
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			Color col = source[i], ret;
+			for (uint32_t k = 0; k < 3; k++)
+				ret[order[k]] = col[k];
+			dest[i] = ret;
+		}
+	}
+
+	void LumaLayout::ToPlanar420(const Color* source, uint32_t width, uint32_t height, uint8_t* y, uint8_t* u, uint8_t* v,
+		uint32_t yStride, uint32_t uvStride)
+	{
+		for (uint32_t row = 0; row < height; row++)
+			for (uint32_t x = 0; x < width; x++)
+				y[row * yStride + x] = source[row * width + x].x;
+
+		for (uint32_t row = 0; row < height; row += 2)
+		{
+			uint32_t nextRow = row + 1 < height ? row + 1 : row;
+			for (uint32_t x = 0; x < width; x += 2)
+			{
+				uint32_t nextX = x + 1 < width ? x + 1 : x;
+				const Color& a = source[row * width + x];
+				const Color& b = source[row * width + nextX];
+				const Color& c = source[nextRow * width + x];
+				const Color& d = source[nextRow * width + nextX];
+
+				u[(row / 2) * uvStride + x / 2] = (a.y + b.y + c.y + d.y + 2) >> 2;
+				v[(row / 2) * uvStride + x / 2] = (a.z + b.z + c.z + d.z + 2) >> 2;
+			}
+		}
+	}
+
+	void LumaLayout::FromPlanar420(Color* dest, uint32_t width, uint32_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+		uint32_t yStride, uint32_t uvStride)
+	{
+		for (uint32_t row = 0; row < height; row++)
+		{
+			const uint8_t* uRow = u + (row / 2) * uvStride;
+			const uint8_t* vRow = v + (row / 2) * uvStride;
+			for (uint32_t x = 0; x < width; x++)
+				dest[row * width + x] = Color(y[row * yStride + x], uRow[x / 2], vRow[x / 2]);
+		}
+	}
+}
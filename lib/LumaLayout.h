@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <DataStructs/Vec3.h>
+
+namespace DStream
+{
+	// Moves the coarse channel of a coder (see Coder::GetCoarseChannel) first, followed by the other two in their
+	// order. Stored as YCbCr without colour conversion, the coarse channel becomes luma and keeps its full resolution,
+	// while the refinement channels end up in the subsampled chroma planes of 4:2:0 JPEG and lossy WebP.
+	class LumaLayout
+	{
+	public:
+		static std::array<uint8_t, 3> GetOrder(uint8_t coarseChannel);
+
+		// dest can be the same as source
+		static void Apply(Color* dest, const Color* source, uint32_t nElements, uint8_t coarseChannel);
+		static void Revert(Color* dest, const Color* source, uint32_t nElements, uint8_t coarseChannel);
+
+		// Splits colours in luma priority layout into 4:2:0 planes, chroma is the rounded average of each 2x2 block
+		static void ToPlanar420(const Color* source, uint32_t width, uint32_t height, uint8_t* y, uint8_t* u, uint8_t* v,
+			uint32_t yStride, uint32_t uvStride);
+		// Nearest neighbour chroma upsampling, so that every pixel gets the value its block was coded with
+		static void FromPlanar420(Color* dest, uint32_t width, uint32_t height, const uint8_t* y, const uint8_t* u, const uint8_t* v,
+			uint32_t yStride, uint32_t uvStride);
+	};
+}
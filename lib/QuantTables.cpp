@@ -0,0 +1,123 @@
+#include <QuantTables.h>
+
+#include <Implementations/Hilbert.h>
+#include <Implementations/Hue.h>
+#include <Implementations/Morton.h>
+#include <Implementations/Packed2.h>
+#include <Implementations/Packed3.h>
+#include <Implementations/Phase.h>
+#include <Implementations/Split2.h>
+#include <Implementations/Split3.h>
+#include <Implementations/Triangle.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace DStream
+{
+	template <typename T>
+	std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<T>& coder, const Color* colors, uint32_t nElements)
+	{
+		const uint32_t nDeltas = 8;
+		const int deltas[nDeltas] = { -8, -4, -2, -1, 1, 2, 4, 8 };
+		uint32_t sampleStep = std::max(1u, nElements / 16384);
+		std::array<float, 3> sensitivity = { 0, 0, 0 };
+		std::vector<Color> perturbed;
+		std::vector<uint16_t> decoded;
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			perturbed.clear();
+			std::vector<float> weights;
+			for (uint32_t i = 0; i < nElements; i += sampleStep)
+			{
+				perturbed.push_back(colors[i]);
+				weights.push_back(0);
+				for (uint32_t d = 0; d < nDeltas; d++)
+				{
+					Color col = colors[i];
+					col[c] = (uint8_t)std::clamp((int)col[c] + deltas[d], 0, 255);
+					perturbed.push_back(col);
+					weights.push_back(col[c] == colors[i][c] ? 0.0f : 1.0f / std::abs((int)col[c] - (int)colors[i][c]));
+				}
+			}
+
+			decoded.resize(perturbed.size());
+			coder.Decode(decoded.data(), perturbed.data(), perturbed.size());
+
+			float sum = 0;
+			uint32_t count = 0;
+			for (uint32_t i = 0; i < perturbed.size(); i += nDeltas + 1)
+			{
+				for (uint32_t d = 1; d <= nDeltas; d++)
+				{
+					if (weights[i + d] == 0)
+						continue;
+					sum += std::abs((int)decoded[i + d] - (int)decoded[i]) * weights[i + d];
+					count++;
+				}
+			}
+			sensitivity[c] = count ? sum / count : 0;
+		}
+
+		return sensitivity;
+	}
+
+	std::vector<std::array<unsigned int, 64>> QuantTables::Derive(const std::array<float, 3>& sensitivity)
+	{
+		static const unsigned int luminance[64] = {
+			16, 11, 10, 16, 24, 40, 51, 61,
+			12, 12, 14, 19, 26, 58, 60, 55,
+			14, 13, 16, 24, 40, 57, 69, 56,
+			14, 17, 22, 29, 51, 87, 80, 62,
+			18, 22, 37, 56, 68, 109, 103, 77,
+			24, 35, 55, 64, 81, 104, 113, 92,
+			49, 64, 78, 87, 103, 121, 120, 101,
+			72, 92, 95, 98, 112, 100, 103, 99
+		};
+
+		float least = 0;
+		for (float s : sensitivity)
+			if (s > 0 && (least == 0 || s < least))
+				least = s;
+
+		std::vector<std::array<unsigned int, 64>> tables(3);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			for (uint32_t k = 0; k < 64; k++)
+			{
+				float q = sensitivity[c] > 0 ? luminance[k] * least / sensitivity[c] : 255;
+				tables[c][k] = (unsigned int)std::clamp((int)std::lround(q), 1, 255);
+			}
+		}
+
+		return tables;
+	}
+
+	template <typename T>
+	std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<T>& coder, const Color* colors, uint32_t nElements)
+	{
+		return Derive(GetChannelSensitivity(coder, colors, nElements));
+	}
+
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Hilbert>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Morton>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Hue>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Phase>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Triangle>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Packed2>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Split2>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Split3>&, const Color*, uint32_t);
+	template std::vector<std::array<unsigned int, 64>> QuantTables::Derive(StreamCoder<Packed3>&, const Color*, uint32_t);
+
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Hilbert>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Morton>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Hue>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Phase>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Triangle>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Packed2>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Split2>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Split3>&, const Color*, uint32_t);
+	template std::array<float, 3> QuantTables::GetChannelSensitivity(StreamCoder<Packed3>&, const Color*, uint32_t);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <StreamCoder.h>
+
+namespace DStream
+{
+	// JPEG quantization tables fitted to the colours of a coder, one per channel in natural order (see
+	// JpegEncoder::setQuantTables). Channels whose errors move depth the most get the finest steps.
+	class QuantTables
+	{
+	public:
+		// Mean depth error per unit of error on each channel, measured by moving the colours of a sample of pixels by
+		// amounts in the range of JPEG errors: single steps alone can fall inside a quantization bin of the coder
+		template <typename T>
+		static std::array<float, 3> GetChannelSensitivity(StreamCoder<T>& coder, const Color* colors, uint32_t nElements);
+		// Scales the IJG luminance table by how sensitive each channel is: the least sensitive channel keeps it, the
+		// others get proportionally finer steps. Channels that don't affect depth get the coarsest table
+		static std::vector<std::array<unsigned int, 64>> Derive(const std::array<float, 3>& sensitivity);
+		// Tables of the colours that coder encoded a frame to
+		template <typename T>
+		static std::vector<std::array<unsigned int, 64>> Derive(StreamCoder<T>& coder, const Color* colors, uint32_t nElements);
+	};
+}
@@ -0,0 +1,75 @@
+#include <Simd.h>
+
+#include <cstdint>
+
+#ifdef DSTREAM_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+namespace DStream
+{
+#ifdef DSTREAM_X86
+	static void CpuId(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+	{
+	#if defined(_MSC_VER) && !defined(__clang__)
+		__cpuidex((int*)regs, leaf, subLeaf);
+	#else
+		__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+	}
+
+	// Registers the OS saves on context switches
+	static uint64_t GetEnabledStates()
+	{
+	#if defined(_MSC_VER) && !defined(__clang__)
+		return _xgetbv(0);
+	#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+	#endif
+	}
+
+	static CpuFeatures DetectFeatures()
+	{
+		CpuFeatures ret;
+		uint32_t regs[4];
+
+		CpuId(0, 0, regs);
+		uint32_t maxLeaf = regs[0];
+		if (maxLeaf < 1)
+			return ret;
+
+		CpuId(1, 0, regs);
+		ret.SSE41 = (regs[2] >> 19) & 1;
+		bool osSavesYmm = ((regs[2] >> 27) & 1) && (GetEnabledStates() & 0x6) == 0x6;
+		bool osSavesZmm = osSavesYmm && (GetEnabledStates() & 0xE6) == 0xE6;
+		ret.F16C = osSavesYmm && ((regs[2] >> 29) & 1);
+
+		if (maxLeaf >= 7)
+		{
+			CpuId(7, 0, regs);
+			ret.AVX2 = osSavesYmm && ((regs[1] >> 5) & 1);
+			ret.AVX512BW = osSavesZmm && ((regs[1] >> 16) & 1) && ((regs[1] >> 30) & 1);
+			ret.AVX512VBMI = ret.AVX512BW && ((regs[2] >> 1) & 1);
+		}
+
+		return ret;
+	}
+#else
+	static CpuFeatures DetectFeatures()
+	{
+		return CpuFeatures();
+	}
+#endif
+
+	const CpuFeatures& CpuFeatures::Get()
+	{
+		static CpuFeatures features = DetectFeatures();
+		return features;
+	}
+}
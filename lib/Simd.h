@@ -0,0 +1,29 @@
+#pragma once
+
+// SIMD kernels are compiled for their instruction set with DSTREAM_TARGET and selected at runtime
+// with CpuFeatures, so that the library itself doesn't need to be built with -mavx2 or /arch:AVX2.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define DSTREAM_X86
+	#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define DSTREAM_TARGET(isa)
+#else
+	#define DSTREAM_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace DStream
+{
+	struct CpuFeatures
+	{
+		bool SSE41 = false;
+		bool AVX2 = false;
+		bool AVX512BW = false;
+		bool AVX512VBMI = false;
+		bool F16C = false;
+
+		static const CpuFeatures& Get();
+	};
+}
@@ -1,4 +1,5 @@
 #include <StreamCoder.h>
+#include <TableGather.h>
 #include <Implementations/Hilbert.h>
 #include <Implementations/Hue.h>
 #include <Implementations/Phase.h>
@@ -8,6 +9,9 @@
 #include <Implementations/Packed3.h>
 #include <Implementations/Split3.h>
 
+#include <typeinfo>
+#include <cstring>
+
 static void TransposeAdvanceToRange(std::vector<uint16_t>& vec, uint16_t rangeMax)
 {
 	uint32_t currSum = 0;
@@ -77,9 +81,12 @@ namespace DStream
 
 	template <typename CoderImplementation>
 	StreamCoder<CoderImplementation>::StreamCoder(bool enlarge, bool interpolate, uint8_t algoBits,
-		std::vector<uint8_t> channelDistribution, bool useTables /* = true*/)
+		std::vector<uint8_t> channelDistribution, bool useTables /* = true*/, TableLayout tableLayout /* = TableLayout::Linear*/,
+		bool lazyTables /* = false*/)
 	{
 		m_UseTables = useTables;
+		m_TableLayout = tableLayout;
+		m_LazyTables = lazyTables;
 		m_Enlarge = enlarge;
 		m_Interpolate = interpolate;
 
@@ -98,6 +105,9 @@ namespace DStream
 		if (tot < 65535)
 			m_Enlarge = false;
 
+		if (m_Interpolate)
+			PrepareInterpolation();
+
 		// Generate tables
 		if (m_Enlarge)
 			GenerateSpacingTables();
@@ -109,10 +119,21 @@ namespace DStream
 	void StreamCoder<CoderImplementation>::Encode(Color* dest, const uint16_t* source, uint32_t nElements)
 	{
 		uint32_t segmentSize = 256 / (1 << m_AlgoBits);
+		if constexpr (HasEncodeBatch<CoderImplementation>::value)
+		{
+			// Batch encoders are cheaper than the table lookup, unless the table has been replaced
+			if (!m_Interpolate && !m_Enlarge && !(m_UseTables && m_CustomTables))
+			{
+				m_Implementation.EncodeBatch(dest, source, nElements);
+				return;
+			}
+		}
+
 		if (m_UseTables)
 		{
+			const Color* table = m_Tables->GetEncodingTable();
 			for (uint32_t i = 0; i < nElements; i++)
-				dest[i] = m_EncodingTable[source[i]];
+				dest[i] = table[source[i]];
 		}
 		else
 			EncodeWithoutTables(dest, source, nElements);
@@ -123,22 +144,241 @@ namespace DStream
 	template<class CoderImplementation>
 	void StreamCoder<CoderImplementation>::Decode(uint16_t* dest, const Color* source, uint32_t nElements)
 	{
-		if (m_UseTables)
+		m_Stats.DecodedValues.fetch_add(nElements, std::memory_order_relaxed);
+
+		if (m_DecodeCache && m_UseTables)
 		{
-			for (uint32_t i = 0; i < nElements; i++)
-				dest[i] = m_DecodingTable[source[i][0]*256*256 + source[i][1]*256 + source[i][2]];
+			const CodingTables& tables = *m_Tables;
+			auto fill = [this](uint32_t block, uint16_t* decodingTable) { FillTableBlock(block, decodingTable); };
+
+			DecodeCached(dest, source, nElements, [&](const Color& col) {
+				uint32_t block = CodingTables::GetBlock(col.x, col.y, col.z);
+				if (!tables.IsBlockReady(block))
+					tables.FillBlock(block, fill);
+				return tables.GetDecodingTable()[TableIndex::Get(m_TableLayout, col.x, col.y, col.z)];
+			});
+		}
+		else if (m_DecodeCache)
+			DecodeCached(dest, source, nElements, [this](const Color& col) { return DecodeSingle(col); });
+		else if (m_UseTables && !m_Tables->IsComplete())
+		{
+			switch (m_TableLayout)
+			{
+			case TableLayout::Blocked:	DecodeWithLazyTables<TableIndex::Blocked>(dest, source, nElements); break;
+			case TableLayout::Morton:	DecodeWithLazyTables<TableIndex::Morton>(dest, source, nElements); break;
+			default:					DecodeWithLazyTables<TableIndex::Linear>(dest, source, nElements); break;
+			}
+		}
+		else if (m_UseTables)
+		{
+			switch (m_TableLayout)
+			{
+			case TableLayout::Blocked:	DecodeWithTables<TableIndex::Blocked>(dest, source, nElements); break;
+			case TableLayout::Morton:	DecodeWithTables<TableIndex::Morton>(dest, source, nElements); break;
+			default:					DecodeWithTables<TableIndex::Linear>(dest, source, nElements); break;
+			}
 		}
 		else
 			DecodeWithoutTables(dest, source, nElements);
 	}
 
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::Encode(const ImageView& dest, const uint16_t* source, uint32_t sourceStride /* = 0*/)
+	{
+		if (sourceStride == 0)
+			sourceStride = dest.Width;
+
+		if (dest.IsPackedRGB() && sourceStride == dest.Width)
+		{
+			Encode((Color*)dest.Planes[0], source, dest.Width * dest.Height);
+			return;
+		}
+
+		Color colors[DepthBatchSize];
+		for (uint32_t y = 0; y < dest.Height; y++)
+		{
+			const uint16_t* row = source + (size_t)y * sourceStride;
+			for (uint32_t x = 0; x < dest.Width; x += DepthBatchSize)
+			{
+				uint32_t count = std::min(DepthBatchSize, dest.Width - x);
+				if (dest.Format == PixelFormat::RGB)
+					Encode((Color*)(dest.Planes[0] + y * dest.Stride) + x, row + x, count);
+				else
+				{
+					Encode(colors, row + x, count);
+					dest.Store(x, y, count, colors);
+				}
+			}
+		}
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::Decode(uint16_t* dest, const ImageView& source, uint32_t destStride /* = 0*/)
+	{
+		if (destStride == 0)
+			destStride = source.Width;
+
+		if (source.IsPackedRGB() && destStride == source.Width)
+		{
+			Decode(dest, (const Color*)source.Planes[0], source.Width * source.Height);
+			return;
+		}
+
+		Color colors[DepthBatchSize];
+		for (uint32_t y = 0; y < source.Height; y++)
+		{
+			uint16_t* row = dest + (size_t)y * destStride;
+			for (uint32_t x = 0; x < source.Width; x += DepthBatchSize)
+			{
+				uint32_t count = std::min(DepthBatchSize, source.Width - x);
+				if (source.Format == PixelFormat::RGB)
+					Decode(row + x, (const Color*)(source.Planes[0] + y * source.Stride) + x, count);
+				else
+				{
+					source.Load(x, y, count, colors);
+					Decode(row + x, colors, count);
+				}
+			}
+		}
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::DecodeRegion(uint16_t* dest, uint32_t destStride, const Color* source, uint32_t sourceStride,
+		uint32_t width, uint32_t height)
+	{
+		Decode(dest, ImageView::Interleaved((uint8_t*)source, width, height, PixelFormat::RGB, (size_t)sourceStride * 3), destStride);
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::DecodeToDepth(float* dest, const Color* source, uint32_t nElements, const DepthRange& range,
+		const uint8_t* mask /* = nullptr*/, float noData /* = NaN*/)
+	{
+		DecodeToDepthBatched(dest, source, nElements, range, mask, noData);
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::DecodeToDepth(Half* dest, const Color* source, uint32_t nElements, const DepthRange& range,
+		const uint8_t* mask /* = nullptr*/, float noData /* = NaN*/)
+	{
+		DecodeToDepthBatched(dest, source, nElements, range, mask, noData);
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::DecodeToDepth(float* dest, const Color* source, uint32_t width, uint32_t firstRow, uint32_t nRows,
+		const TileRanges& ranges, const uint8_t* mask /* = nullptr*/, float noData /* = NaN*/)
+	{
+		uint32_t tileSize = ranges.TileSize, tilesX = (width + tileSize - 1) / tileSize;
+		for (uint32_t y = 0; y < nRows; y++)
+		{
+			const DepthRange* rowRanges = ranges.Ranges.data() + ((firstRow + y) / tileSize) * tilesX;
+			size_t row = (size_t)y * width;
+			for (uint32_t x = 0, tx = 0; x < width; x += tileSize, tx++)
+			{
+				uint32_t count = std::min(tileSize, width - x);
+				DecodeToDepthBatched(dest + row + x, source + row + x, count, rowRanges[tx], mask ? mask + row + x : nullptr, noData);
+			}
+		}
+	}
+
+	template<class CoderImplementation>
+	template <typename T>
+	void StreamCoder<CoderImplementation>::DecodeToDepthBatched(T* dest, const Color* source, uint32_t nElements, const DepthRange& range,
+		const uint8_t* mask, float noData)
+	{
+		uint16_t values[DepthBatchSize];
+		for (uint32_t start = 0; start < nElements; start += DepthBatchSize)
+		{
+			uint32_t count = std::min(DepthBatchSize, nElements - start);
+			Decode(values, source + start, count);
+			DepthProcessing::Dequantize(dest + start, values, count, range, mask ? mask + start : nullptr, noData);
+		}
+	}
+
+	template<class CoderImplementation>
+	template <uint32_t (*Index)(uint8_t, uint8_t, uint8_t)>
+	void StreamCoder<CoderImplementation>::DecodeWithTables(uint16_t* dest, const Color* source, uint32_t nElements)
+	{
+		// Software pipeline: the indices of a batch are computed and prefetched while the previous batch is gathered
+		const uint32_t batchSize = 64;
+		const uint16_t* table = m_Tables->GetDecodingTable();
+		uint32_t indices[2][batchSize];
+		uint32_t prevStart = 0, prevCount = 0;
+
+		for (uint32_t start = 0; start < nElements; start += batchSize)
+		{
+			uint32_t count = std::min(batchSize, nElements - start);
+			uint32_t* batch = indices[(start / batchSize) & 1];
+			for (uint32_t i = 0; i < count; i++)
+				batch[i] = Index(source[start + i].x, source[start + i].y, source[start + i].z);
+			TableGather::Prefetch(table, batch, count);
+
+			if (prevCount)
+				TableGather::Gather(dest + prevStart, table, indices[((start / batchSize) & 1) ^ 1], prevCount);
+			prevStart = start;
+			prevCount = count;
+		}
+
+		if (prevCount)
+			TableGather::Gather(dest + prevStart, table, indices[(prevStart / batchSize) & 1], prevCount);
+	}
+
+	template<class CoderImplementation>
+	template <uint32_t (*Index)(uint8_t, uint8_t, uint8_t)>
+	void StreamCoder<CoderImplementation>::DecodeWithLazyTables(uint16_t* dest, const Color* source, uint32_t nElements)
+	{
+		const CodingTables& tables = *m_Tables;
+		const uint16_t* table = tables.GetDecodingTable();
+		auto fill = [this](uint32_t block, uint16_t* decodingTable) { FillTableBlock(block, decodingTable); };
+
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			uint32_t block = CodingTables::GetBlock(source[i].x, source[i].y, source[i].z);
+			if (!tables.IsBlockReady(block))
+				tables.FillBlock(block, fill);
+			dest[i] = table[Index(source[i].x, source[i].y, source[i].z)];
+		}
+	}
+
 	template<class CoderImplementation>
 	void StreamCoder<CoderImplementation>::EncodeWithoutTables(Color* dest, const uint16_t* source, uint32_t nElements)
+	{
+		if (!m_Enlarge)
+		{
+			EncodeValues(dest, source, nElements);
+			return;
+		}
+
+		for (uint32_t start = 0; start < nElements; start += RemapBatchSize)
+		{
+			uint32_t count = std::min(RemapBatchSize, nElements - start);
+			EncodeValues(dest + start, source + start, count);
+			Enlarge(dest + start, dest + start, count);
+		}
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::EncodeValues(Color* dest, const uint16_t* source, uint32_t nElements)
 	{
 		Color prev, curr;
 		uint16_t nSegments = (1 << (m_AlgoBits * 3)) - 1;
 		uint16_t maxVal = 0;
 
+		if constexpr (HasEncodeBatch<CoderImplementation>::value)
+		{
+			if (!m_Interpolate)
+			{
+				m_Implementation.EncodeBatch(dest, source, nElements);
+				return;
+			}
+		}
+
+		if (m_Interpolate && !m_ScaledColors.empty())
+		{
+			for (uint32_t i = 0; i < nElements; i++)
+				dest[i] = EncodeInterpolatedFixed(source[i]);
+			return;
+		}
+
 		for (uint32_t i = 0; i < nElements; i++)
 		{
 			if (m_Interpolate)
@@ -174,29 +414,120 @@ namespace DStream
 					dest[i] = m_Implementation.EncodeValue(source[i]);
 			}
 		}
+	}
+
+	template<class CoderImplementation>
+	template <typename DecodeMiss>
+	void StreamCoder<CoderImplementation>::DecodeCached(uint16_t* dest, const Color* source, uint32_t nElements, DecodeMiss decodeMiss)
+	{
+		// 1024 entries, 6KB: fits in L1 together with the input and output rows
+		const uint32_t cacheBits = 10;
+		const uint32_t invalidKey = 0xFFFFFFFF;
+
+		uint32_t keys[1 << cacheBits];
+		uint16_t values[1 << cacheBits];
+		std::fill(keys, keys + (1 << cacheBits), invalidKey);
+
+		uint32_t lastKey = invalidKey;
+		uint16_t lastValue = 0;
+		uint64_t hits = 0;
+
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+			uint32_t key = ((uint32_t)source[i].x << 16) | ((uint32_t)source[i].y << 8) | source[i].z;
+
+			// Runs of the same colour skip the hash too
+			if (key != lastKey)
+			{
+				uint32_t slot = (key * 2654435761u) >> (32 - cacheBits);
+				if (keys[slot] == key)
+					hits++;
+				else
+				{
+					keys[slot] = key;
+					values[slot] = decodeMiss(source[i]);
+				}
+
+				lastKey = key;
+				lastValue = values[slot];
+			}
+			else
+				hits++;
+
+			dest[i] = lastValue;
+		}
+
+		m_Stats.CacheLookups.fetch_add(nElements, std::memory_order_relaxed);
+		m_Stats.CacheHits.fetch_add(hits, std::memory_order_relaxed);
+	}
 
+	template<class CoderImplementation>
+	uint16_t StreamCoder<CoderImplementation>::DecodeSingle(Color col)
+	{
 		if (m_Enlarge)
-			Enlarge(dest, dest, nElements);
+			for (uint32_t k = 0; k < 3; k++)
+				col[k] = m_SpacingTable.Shrink[k][col[k]];
+
+		if (m_Interpolate)
+			return m_LatticeValues.empty() ? InterpolateHeight(col) : InterpolateHeightFixed(col);
+		else if (std::is_same<Hilbert, CoderImplementation>())
+			return m_Implementation.DecodeValue(col) << (16 - m_AlgoBits * 3);
+		else if constexpr (HasDecodeBatch<CoderImplementation>::value)
+		{
+			uint16_t ret;
+			m_Implementation.DecodeBatch(&ret, &col, 1);
+			return ret;
+		}
+		else
+			return m_Implementation.DecodeValue(col);
 	}
 
 	template<class CoderImplementation>
 	void StreamCoder<CoderImplementation>::DecodeWithoutTables(uint16_t* dest, const Color* source, uint32_t nElements)
 	{
-		Color* inCols = new Color[nElements];
-		memcpy(inCols, source, 3 * nElements);// (Color*)source;
-		if (m_Enlarge)
-			Shrink(source, inCols, nElements);
+		if (!m_Enlarge)
+		{
+			DecodeValues(dest, source, nElements);
+			return;
+		}
+
+		Color shrunk[RemapBatchSize];
+		for (uint32_t start = 0; start < nElements; start += RemapBatchSize)
+		{
+			uint32_t count = std::min(RemapBatchSize, nElements - start);
+			Shrink(source + start, shrunk, count);
+			DecodeValues(dest + start, shrunk, count);
+		}
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::DecodeValues(uint16_t* dest, const Color* source, uint32_t nElements)
+	{
+		if constexpr (HasDecodeBatch<CoderImplementation>::value)
+		{
+			if (!m_Interpolate)
+			{
+				m_Implementation.DecodeBatch(dest, source, nElements);
+				return;
+			}
+		}
+
+		if (m_Interpolate && !m_LatticeValues.empty())
+		{
+			for (uint32_t i = 0; i < nElements; i++)
+				dest[i] = InterpolateHeightFixed(source[i]);
+			return;
+		}
 
 		for (uint32_t i = 0; i < nElements; i++)
 		{
 			if (m_Interpolate)
-				dest[i] = InterpolateHeight(inCols[i]);
+				dest[i] = InterpolateHeight(source[i]);
 			else if (std::is_same<Hilbert, CoderImplementation>())
-				dest[i] = m_Implementation.DecodeValue(inCols[i]) << (16 - m_AlgoBits * 3);
+				dest[i] = m_Implementation.DecodeValue(source[i]) << (16 - m_AlgoBits * 3);
 			else
-				dest[i] = m_Implementation.DecodeValue(inCols[i]);
+				dest[i] = m_Implementation.DecodeValue(source[i]);
 		}
-		delete[] inCols;
 	}
 
 	template<class CoderImplementation>
@@ -278,35 +609,172 @@ namespace DStream
 	}
 
 	template<class CoderImplementation>
-	void StreamCoder<CoderImplementation>::GenerateCodingTables()
+	void StreamCoder<CoderImplementation>::PrepareInterpolation()
 	{
-		uint32_t maxQuantizationValue = (1 << 16);
-		uint32_t maxAlgoBitsValue = (1 << 8);
+		uint32_t gridSide = (1 << m_AlgoBits) - 1;
+		uint32_t nPoints = 1 << (m_AlgoBits * 3);
 
-		m_DecodingTable.resize(maxAlgoBitsValue * maxAlgoBitsValue * maxAlgoBitsValue);
-		for (uint32_t i = 0; i < maxAlgoBitsValue; i++)
+		m_LatticeValues.clear();
+		m_ScaledColors.clear();
+		// 64KB for both tables at 5 bits, more than that doesn't fit the 16 bits of the encoded values anyway
+		if (m_AlgoBits * 3 > 15)
+			return;
+
+		// Channel value c lies in cell U = c * gridSide / 255 with weight (c * gridSide % 255) / 255 towards U+1
+		for (uint32_t c = 0; c < 256; c++)
 		{
-			for (uint32_t j = 0; j < maxAlgoBitsValue; j++)
-			{
-				for (uint32_t k = 0; k < maxAlgoBitsValue; k++)
-				{
-					Color c = { (uint8_t)i, (uint8_t)j, (uint8_t)k };
-					uint16_t val;
+			uint32_t n = c * gridSide;
+			m_LatticeCell[c] = n / 255;
+			m_LatticeNext[c] = std::min(n / 255 + 1, gridSide);
+			m_LatticeFraction[c] = n % 255;
+		}
 
-					DecodeWithoutTables(&val, &c, 1);
-					m_DecodingTable[i * maxAlgoBitsValue * maxAlgoBitsValue + j * maxAlgoBitsValue + k] = val;
-				}
-			}
+		m_LatticeValues.resize(nPoints);
+		for (uint32_t u = 0; u <= gridSide; u++)
+			for (uint32_t v = 0; v <= gridSide; v++)
+				for (uint32_t w = 0; w <= gridSide; w++)
+					m_LatticeValues[(u << (2 * m_AlgoBits)) | (v << m_AlgoBits) | w] = m_Implementation.DecodeValue(Color(u, v, w));
+
+		// The fixed point encoder is within 1 of the float one, but Enlarge spreads a difference of 1 over several
+		// channel values: enlarged coders keep encoding in floating point
+		if (m_Enlarge)
+			return;
+
+		m_ScaledColors.resize(nPoints);
+		for (uint32_t i = 0; i < nPoints; i++)
+		{
+			Color col = m_Implementation.EncodeValue(i);
+			for (uint32_t j = 0; j < 3; j++)
+				m_ScaledColors[i][j] = std::round(((float)col[j] / gridSide) * 255);
+		}
+	}
+
+	// Same as InterpolateHeight, with the weights as exact multiples of 1/255^3
+	template<class CoderImplementation>
+	uint16_t StreamCoder<CoderImplementation>::InterpolateHeightFixed(const Color& col)
+	{
+		const uint32_t shiftU = 2 * m_AlgoBits, shiftV = m_AlgoBits;
+		const int32_t threshold = 1 << m_AlgoBits;
+
+		uint32_t u[2] = { (uint32_t)m_LatticeCell[col.x] << shiftU, (uint32_t)m_LatticeNext[col.x] << shiftU };
+		uint32_t v[2] = { (uint32_t)m_LatticeCell[col.y] << shiftV, (uint32_t)m_LatticeNext[col.y] << shiftV };
+		uint32_t w[2] = { m_LatticeCell[col.z], m_LatticeNext[col.z] };
+
+		uint32_t fu = m_LatticeFraction[col.x], fv = m_LatticeFraction[col.y], fw = m_LatticeFraction[col.z];
+		uint32_t wu[2] = { 255 - fu, fu }, wv[2] = { 255 - fv, fv }, ww[2] = { 255 - fw, fw };
+
+		int32_t vals[8];
+		for (uint32_t i = 0; i < 8; i++)
+			vals[i] = m_LatticeValues[u[i & 1] | v[(i >> 1) & 1] | w[i >> 2]];
+
+		// 255 is odd, a fraction is never exactly 0.5
+		int32_t T = vals[(fu >= 128) + (fv >= 128) * 2 + (fw >= 128) * 4];
+		uint64_t num = 0, tot = 0;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			uint32_t weight = wu[i & 1] * wv[(i >> 1) & 1] * ww[i >> 2];
+			weight = std::abs(vals[i] - T) > threshold ? 0 : weight;
+			num += (uint64_t)weight * vals[i];
+			tot += weight;
 		}
 
-		m_EncodingTable.resize(maxQuantizationValue);
-		Color c;
-		for (uint32_t i = 0; i < maxQuantizationValue; i++)
+		// round(num / tot / nSegments * 65535), T always has a positive weight
+		uint64_t den = tot * ((1 << (m_AlgoBits * 3)) - 1);
+		return (uint16_t)((num * 65535 * 2 + den) / (den * 2));
+	}
+
+	template<class CoderImplementation>
+	Color StreamCoder<CoderImplementation>::EncodeInterpolatedFixed(uint16_t value)
+	{
+		const uint32_t nSegments = (1 << (m_AlgoBits * 3)) - 1;
+		uint32_t n = value * nSegments;
+		uint32_t point = n / 65535, t = n % 65535;
+
+		const Color& a = m_ScaledColors[point];
+		const Color& b = m_ScaledColors[std::min(point + 1, nSegments)];
+
+		// a + round((b - a) * t / 65535), rounding half away from zero like std::round
+		int32_t d[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		for (uint32_t k = 0; k < 3; k++)
 		{
-			uint16_t val = i;
-			EncodeWithoutTables(&c, &val, 1);
-			m_EncodingTable[i] = c;
+			int32_t r = (int32_t)(((uint32_t)std::abs(d[k]) * t * 2 + 65535) / (65535 * 2));
+			d[k] = d[k] < 0 ? -r : r;
 		}
+		return Color(a.x + d[0], a.y + d[1], a.z + d[2]);
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::GenerateCodingTables()
+	{
+		m_CustomTables = false;
+		m_Tables = TableRegistry::Get().Acquire(GetTablesKey(m_TableLayout), m_TableLayout, m_LazyTables, [this](CodingTables& tables) {
+			uint32_t maxQuantizationValue = (1 << 16);
+
+			// Lazy tables only compute the decoding table when needed
+			if (!tables.IsLazy())
+				for (uint32_t block = 0; block < CodingTables::BlockCount; block++)
+					FillTableBlock(block, tables.GetDecodingData());
+
+			Color* encodingTable = tables.GetEncodingData();
+			for (uint32_t i = 0; i < maxQuantizationValue; i++)
+			{
+				uint16_t val = i;
+				EncodeWithoutTables(&encodingTable[i], &val, 1);
+			}
+		});
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::FillTableBlock(uint32_t block, uint16_t* decodingTable)
+	{
+		const uint32_t side = CodingTables::BlockSide;
+		uint32_t startR = (block >> 8) * side, startG = ((block >> 4) & 15) * side, startB = (block & 15) * side;
+
+		Color colors[side * side * side];
+		uint16_t values[side * side * side];
+
+		for (uint32_t i = 0; i < side; i++)
+			for (uint32_t j = 0; j < side; j++)
+				for (uint32_t k = 0; k < side; k++)
+					colors[(i * side + j) * side + k] = Color(startR + i, startG + j, startB + k);
+
+		DecodeWithoutTables(values, colors, side * side * side);
+
+		for (uint32_t i = 0; i < side * side * side; i++)
+			decodingTable[TableIndex::Get(m_TableLayout, colors[i].x, colors[i].y, colors[i].z)] = values[i];
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::CompleteTables()
+	{
+		if (!m_Tables || m_Tables->IsComplete())
+			return;
+
+		auto fill = [this](uint32_t block, uint16_t* decodingTable) { FillTableBlock(block, decodingTable); };
+		for (uint32_t block = 0; block < CodingTables::BlockCount; block++)
+			if (!m_Tables->IsBlockReady(block))
+				m_Tables->FillBlock(block, fill);
+	}
+
+	template<class CoderImplementation>
+	std::string StreamCoder<CoderImplementation>::GetTablesKey(TableLayout layout)
+	{
+		std::string key = typeid(CoderImplementation).name();
+		key += (char)m_AlgoBits;
+		key += (char)m_Enlarge;
+		key += (char)m_Interpolate;
+		key += (char)layout;
+		key += (char)m_LazyTables;
+		for (uint8_t bits : m_Implementation.GetChannelDistribution())
+			key += (char)bits;
+
+		// Custom spacing tables produce different coding tables
+		if (m_Enlarge)
+			for (uint32_t i = 0; i < 3; i++)
+				key.append(m_SpacingTable.Enlarge[i].begin(), m_SpacingTable.Enlarge[i].end())
+					.append(m_SpacingTable.Shrink[i].begin(), m_SpacingTable.Shrink[i].end());
+
+		return key;
 	}
 
 	template<class CoderImplementation>
@@ -396,13 +864,70 @@ namespace DStream
 	template<class CoderImplementation>
 	void StreamCoder<CoderImplementation>::SetEncodingTable(const std::vector<Color>& table)
 	{
-		m_EncodingTable = table;
+		// Shared tables are immutable: custom ones are private to this coder
+		CompleteTables();
+		std::shared_ptr<CodingTables> tables = std::make_shared<CodingTables>(m_TableLayout);
+		if (m_Tables)
+			memcpy(tables->GetDecodingData(), m_Tables->GetDecodingTable(), CodingTables::DecodingTableSize * sizeof(uint16_t));
+		memcpy(tables->GetEncodingData(), table.data(), std::min<size_t>(table.size(), CodingTables::EncodingTableSize) * sizeof(Color));
+		m_Tables = tables;
+		m_CustomTables = true;
 	}
 
 	template<class CoderImplementation>
 	void StreamCoder<CoderImplementation>::SetDecodingTable(const std::vector<uint16_t>& table, uint32_t tableSideX, uint32_t tableSideY, uint32_t tableSideZ)
 	{
-		m_DecodingTable = table;
+		std::shared_ptr<CodingTables> tables = std::make_shared<CodingTables>(m_TableLayout);
+		if (m_Tables)
+			memcpy(tables->GetEncodingData(), m_Tables->GetEncodingTable(), CodingTables::EncodingTableSize * sizeof(Color));
+
+		uint16_t* decodingTable = tables->GetDecodingData();
+		for (uint32_t i = 0; i < 256; i++)
+			for (uint32_t j = 0; j < 256; j++)
+				for (uint32_t k = 0; k < 256; k++)
+					decodingTable[TableIndex::Get(m_TableLayout, i, j, k)] = table[TableIndex::Linear(i, j, k)];
+		m_Tables = tables;
+		m_CustomTables = true;
+	}
+
+	template<class CoderImplementation>
+	void StreamCoder<CoderImplementation>::SetTableLayout(TableLayout layout)
+	{
+		if (layout == m_TableLayout)
+			return;
+
+		if (m_Tables && m_Tables->IsLazy() && !m_CustomTables)
+		{
+			// Blocks will be filled with the new layout
+			m_TableLayout = layout;
+			GenerateCodingTables();
+		}
+		else if (m_Tables)
+		{
+			// Rearrange the current tables instead of generating them again
+			std::shared_ptr<const CodingTables> current = m_Tables;
+			auto rearrange = [&current, layout](CodingTables& tables) {
+				const uint16_t* src = current->GetDecodingTable();
+				uint16_t* dst = tables.GetDecodingData();
+
+				for (uint32_t i = 0; i < 256; i++)
+					for (uint32_t j = 0; j < 256; j++)
+						for (uint32_t k = 0; k < 256; k++)
+							dst[TableIndex::Get(layout, i, j, k)] = src[TableIndex::Get(current->GetLayout(), i, j, k)];
+				memcpy(tables.GetEncodingData(), current->GetEncodingTable(), CodingTables::EncodingTableSize * sizeof(Color));
+			};
+
+			if (m_CustomTables)
+			{
+				std::shared_ptr<CodingTables> tables = std::make_shared<CodingTables>(layout);
+				rearrange(*tables);
+				m_Tables = tables;
+			}
+			else
+				m_Tables = TableRegistry::Get().Acquire(GetTablesKey(layout), layout, false, rearrange);
+		}
+
+		m_TableLayout = layout;
 	}
 
 	template<class CoderImplementation>
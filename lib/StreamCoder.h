@@ -3,8 +3,16 @@
 #include <cstdint>
 #include <unordered_map>
 #include <type_traits>
+#include <memory>
+#include <string>
 
+#include <ChannelRemap.h>
 #include <Coder.h>
+#include <CodingTables.h>
+#include <DepthProcessing.h>
+#include <TileHeader.h>
+#include <DataStructs/CoderStats.h>
+#include <DataStructs/ImageView.h>
 #include <DataStructs/Table.h>
 #include <DataStructs/Vec3.h>
 
@@ -15,45 +23,102 @@ namespace DStream
 	{
 		static_assert(std::is_base_of_v<Coder, CoderImplementation>, "Template parameter of class StreamCoder must derive from Coder.");
 	public:
-		StreamCoder(bool enlarge, bool interpolate, uint8_t algoBits, std::vector<uint8_t> channelDistribution, bool useTables = true);
+		// Lazy tables compute the decoding table one 16^3 block at a time, when a colour of the block is first decoded
+		StreamCoder(bool enlarge, bool interpolate, uint8_t algoBits, std::vector<uint8_t> channelDistribution, bool useTables = true,
+			TableLayout tableLayout = TableLayout::Linear, bool lazyTables = false);
 		StreamCoder() = default;
 		~StreamCoder() = default;
 
 		void Encode(Color* dest, const uint16_t* source, uint32_t nElements);
 		void Decode(uint16_t* dest, const Color* source, uint32_t nElements);
+		// Code width x height depth values to / from the caller's colour buffer, in any pixel format and row stride. Packed
+		// RGB rows are coded in place, other formats go through a cache sized batch of colours, never a full frame. Depth
+		// strides are in elements, 0 means tightly packed rows
+		void Encode(const ImageView& dest, const uint16_t* source, uint32_t sourceStride = 0);
+		void Decode(uint16_t* dest, const ImageView& source, uint32_t destStride = 0);
+		// Decodes a width x height window, strides are in elements
+		void DecodeRegion(uint16_t* dest, uint32_t destStride, const Color* source, uint32_t sourceStride, uint32_t width, uint32_t height);
+		// Decodes straight to depth = range.Offset + value * range.Scale, one cache sized batch at a time, so the 16 bit
+		// values never go through memory. Values whose mask byte is 0 become noData
+		void DecodeToDepth(float* dest, const Color* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask = nullptr,
+			float noData = std::numeric_limits<float>::quiet_NaN());
+		void DecodeToDepth(Half* dest, const Color* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask = nullptr,
+			float noData = std::numeric_limits<float>::quiet_NaN());
+		// Same for rows [firstRow, firstRow + nRows) of a frame quantized in tiles (see DepthProcessing::QuantizeTiled), with
+		// the range of the tile of every value. dest, source and mask point to the first of the rows
+		void DecodeToDepth(float* dest, const Color* source, uint32_t width, uint32_t firstRow, uint32_t nRows, const TileRanges& ranges,
+			const uint8_t* mask = nullptr, float noData = std::numeric_limits<float>::quiet_NaN());
 
 		void GenerateCodingTables();
 		void GenerateSpacingTables();
-		uint16_t* GetDecodingTable() { return m_DecodingTable.data(); }
+		// The returned table is stored according to GetTableLayout(), use TableIndex::Get to address it.
+		// Tables are shared between coders with the same parameters and must not be modified.
+		// Blocks of lazy tables that haven't been decoded yet contain garbage, see CompleteTables.
+		const uint16_t* GetDecodingTable() { return m_Tables ? m_Tables->GetDecodingTable() : nullptr; }
+		const Color* GetEncodingTable() { return m_Tables ? m_Tables->GetEncodingTable() : nullptr; }
+		inline TableLayout GetTableLayout() { return m_TableLayout; }
+		inline uint8_t GetCoarseChannel() { return m_Implementation.GetCoarseChannel(); }
 
 		void SetSpacingTables(SpacingTable tables);
 		void SetEncodingTable(const std::vector<Color>& table);
+		// The table is expected in the Linear layout, it's rearranged to match the current one
 		void SetDecodingTable(const std::vector<uint16_t>& table, uint32_t tableSideX, uint32_t tableSideY, uint32_t tableSideZ);
+		void SetTableLayout(TableLayout layout);
+		// Computes all the blocks of a lazy table that haven't been computed yet
+		void CompleteTables();
+
+		// Puts a small colour -> depth cache in front of the decoder. Consecutive pixels of an encoded depth
+		// image often share their colour, so this mostly pays off when decoding without tables. The cache is shared, so
+		// Decode can't be called on several threads at once while it's enabled
+		inline void SetDecodeCache(bool enabled) { m_DecodeCache = enabled; }
+		// Stats are accumulated once per Decode call
+		inline const CoderStats& GetStats() { return m_Stats; }
+		inline void ResetStats() { m_Stats = CoderStats(); }
 
 		inline Color InterpolateColor(const Color& a, const Color& b, float t);
+		// Floating point reference for the fixed point interpolation used by Encode and Decode
 		uint16_t InterpolateHeight(const Color& c);
 
 		inline void Enlarge(const Color* source, Color* dest, uint32_t nElements)
 		{
-			for (uint32_t i=0; i<nElements; i++)
-				for (int k = 0; k < 3; k++)
-					dest[i][k] = m_SpacingTable.Enlarge[k][source[i][k]];		
+			ChannelRemap::Apply(dest, source, nElements, m_SpacingTable.Enlarge[0].data(), m_SpacingTable.Enlarge[1].data(),
+				m_SpacingTable.Enlarge[2].data());
 		}
 
 		inline void Shrink(const Color* source, Color* dest, uint32_t nElements)
 		{
-			for (uint32_t i = 0; i < nElements; i++)
-				for (int k = 0; k < 3; k++)
-					dest[i][k] = m_SpacingTable.Shrink[k][source[i][k]];
+			ChannelRemap::Apply(dest, source, nElements, m_SpacingTable.Shrink[0].data(), m_SpacingTable.Shrink[1].data(),
+				m_SpacingTable.Shrink[2].data());
 		}
 
 	CoderImplementation m_Implementation;
 
 	private:
+		std::string GetTablesKey(TableLayout layout);
 		std::vector<uint16_t> GetErrorVector(uint16_t* decodingTable, uint32_t tableSide, uint8_t axis, uint8_t amount = 1);
 
+		template <uint32_t (*Index)(uint8_t, uint8_t, uint8_t)>
+		void DecodeWithTables(uint16_t* dest, const Color* source, uint32_t nElements);
+		template <uint32_t (*Index)(uint8_t, uint8_t, uint8_t)>
+		void DecodeWithLazyTables(uint16_t* dest, const Color* source, uint32_t nElements);
+		void FillTableBlock(uint32_t block, uint16_t* decodingTable);
+		template <typename DecodeMiss>
+		void DecodeCached(uint16_t* dest, const Color* source, uint32_t nElements, DecodeMiss decodeMiss);
+		inline uint16_t DecodeSingle(Color col);
 		void DecodeWithoutTables(uint16_t* dest, const Color* source, uint32_t nElements);
 		void EncodeWithoutTables(Color* dest, const uint16_t* source, uint32_t nElements);
+		// Without Shrink / Enlarge, which the functions above apply one L1 sized batch at a time
+		void DecodeValues(uint16_t* dest, const Color* source, uint32_t nElements);
+		void EncodeValues(Color* dest, const uint16_t* source, uint32_t nElements);
+		static constexpr uint32_t RemapBatchSize = 512;
+		template <typename T>
+		void DecodeToDepthBatched(T* dest, const Color* source, uint32_t nElements, const DepthRange& range, const uint8_t* mask, float noData);
+		// 8KB of decoded values, large enough to amortize the setup of the decode cache
+		static constexpr uint32_t DepthBatchSize = 4096;
+
+		void PrepareInterpolation();
+		inline uint16_t InterpolateHeightFixed(const Color& c);
+		inline Color EncodeInterpolatedFixed(uint16_t value);
 
 	private:
 		bool m_UseTables;
@@ -62,10 +127,25 @@ namespace DStream
 
 		uint32_t m_AlgoBits;
 		uint32_t m_EnlargeBits;
+
+		TableLayout m_TableLayout = TableLayout::Linear;
+		bool m_LazyTables = false;
 		
 		SpacingTable m_SpacingTable;
-		std::vector<Color> m_EncodingTable;
-		std::vector<uint16_t> m_DecodingTable;
+		std::shared_ptr<const CodingTables> m_Tables;
+		bool m_CustomTables = false;
+
+		bool m_DecodeCache = false;
+		CoderStats m_Stats;
+
+		// Fixed point interpolation: lattice cell, next cell and fraction (in 255ths) of every channel value,
+		// decoded lattice points and encoded points scaled to [0, 255]. Empty if the lattice is too big, the
+		// scaled colors also if the coder enlarges.
+		uint8_t m_LatticeCell[256];
+		uint8_t m_LatticeNext[256];
+		uint8_t m_LatticeFraction[256];
+		std::vector<uint16_t> m_LatticeValues;
+		std::vector<Color> m_ScaledColors;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <TableGather.h>
+#include <Simd.h>
+
+namespace DStream
+{
+#ifdef DSTREAM_X86
+	// 32 bit gathers at 2 byte offsets: the upper half of each lane belongs to the next entry
+	DSTREAM_TARGET("avx2") static uint32_t GatherAVX2(uint16_t* dest, const uint16_t* table, const uint32_t* indices, uint32_t nElements)
+	{
+		const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+		uint32_t i = 0;
+
+		for (; i + 16 <= nElements; i += 16)
+		{
+			__m256i a = _mm256_i32gather_epi32((const int*)table, _mm256_loadu_si256((const __m256i*)(indices + i)), 2);
+			__m256i b = _mm256_i32gather_epi32((const int*)table, _mm256_loadu_si256((const __m256i*)(indices + i + 8)), 2);
+			__m256i values = _mm256_packus_epi32(_mm256_and_si256(a, lowMask), _mm256_and_si256(b, lowMask));
+			_mm256_storeu_si256((__m256i*)(dest + i), _mm256_permute4x64_epi64(values, 0xD8));
+		}
+
+		return i;
+	}
+#endif
+
+	void TableGather::Gather(uint16_t* dest, const uint16_t* table, const uint32_t* indices, uint32_t nElements)
+	{
+		uint32_t i = 0;
+#ifdef DSTREAM_X86
+		if (CpuFeatures::Get().AVX2)
+			i = GatherAVX2(dest, table, indices, nElements);
+#endif
+		for (; i + 4 <= nElements; i += 4)
+		{
+			uint16_t a = table[indices[i]], b = table[indices[i + 1]], c = table[indices[i + 2]], d = table[indices[i + 3]];
+			dest[i] = a; dest[i + 1] = b; dest[i + 2] = c; dest[i + 3] = d;
+		}
+		for (; i < nElements; i++)
+			dest[i] = table[indices[i]];
+	}
+
+	void TableGather::Prefetch(const uint16_t* table, const uint32_t* indices, uint32_t nElements)
+	{
+		for (uint32_t i = 0; i < nElements; i++)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+	#ifdef DSTREAM_X86
+			_mm_prefetch((const char*)(table + indices[i]), _MM_HINT_T0);
+	#endif
+#else
+			__builtin_prefetch(table + indices[i]);
+#endif
+		}
+	}
+}
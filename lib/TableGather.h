@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DStream
+{
+	// Batched lookups in a decoding table. Gather uses AVX2 gathers if available, otherwise independent loads:
+	// in both cases many cache misses are in flight at the same time instead of one per pixel.
+	class TableGather
+	{
+	public:
+		// The table must be readable for 2 bytes after its last entry, which is true for CodingTables
+		static void Gather(uint16_t* dest, const uint16_t* table, const uint32_t* indices, uint32_t nElements);
+		static void Prefetch(const uint16_t* table, const uint32_t* indices, uint32_t nElements);
+	};
+}
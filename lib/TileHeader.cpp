@@ -0,0 +1,139 @@
+#include <TileHeader.h>
+
+#include <cstring>
+
+namespace DStream
+{
+	static inline void WriteLE(uint8_t* dest, uint32_t v)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			dest[i] = v >> (i * 8);
+	}
+
+	static inline uint32_t ReadLE(const uint8_t* src)
+	{
+		return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+	}
+
+	static inline void WriteRange(uint8_t* dest, const DepthRange& range)
+	{
+		uint32_t offset, scale;
+		memcpy(&offset, &range.Offset, 4);
+		memcpy(&scale, &range.Scale, 4);
+		WriteLE(dest, offset);
+		WriteLE(dest + 4, scale);
+	}
+
+	static inline DepthRange ReadRange(const uint8_t* src)
+	{
+		DepthRange range;
+		uint32_t offset = ReadLE(src), scale = ReadLE(src + 4);
+		memcpy(&range.Offset, &offset, 4);
+		memcpy(&range.Scale, &scale, 4);
+		return range;
+	}
+
+	static inline size_t GetTileCount(uint32_t width, uint32_t height, uint32_t tileSize)
+	{
+		return (size_t)((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+	}
+
+	void TileHeader::Write(std::vector<uint8_t>& dest) const
+	{
+		dest.resize(Size);
+		memcpy(dest.data(), "dstl", 4);
+		dest[4] = (uint8_t)Coder;
+		dest[5] = AlgoBits;
+		dest[6] = (Enlarge ? 1 : 0) | (Interpolate ? 2 : 0);
+		dest[7] = Quality;
+		WriteRange(dest.data() + 8, Range);
+	}
+
+	bool TileHeader::Read(const uint8_t* source, size_t size)
+	{
+		if (size < Size || memcmp(source, "dstl", 4) != 0 || source[4] >= (uint8_t)CoderType::Count || source[5] < 1 || source[5] > 8)
+			return false;
+
+		Coder = (CoderType)source[4];
+		AlgoBits = source[5];
+		Enlarge = source[6] & 1;
+		Interpolate = source[6] & 2;
+		Quality = source[7];
+		Range = ReadRange(source + 8);
+		return true;
+	}
+
+	void TileRanges::Write(std::vector<uint8_t>& dest) const
+	{
+		dest.resize(HeaderSize + Ranges.size() * 8);
+		memcpy(dest.data(), "dstr", 4);
+		WriteLE(dest.data() + 4, TileSize);
+		WriteLE(dest.data() + 8, (uint32_t)Ranges.size());
+		for (size_t i = 0; i < Ranges.size(); i++)
+			WriteRange(dest.data() + HeaderSize + i * 8, Ranges[i]);
+	}
+
+	size_t TileRanges::Read(const uint8_t* source, size_t size)
+	{
+		if (size < HeaderSize || memcmp(source, "dstr", 4) != 0)
+			return 0;
+
+		uint32_t count = ReadLE(source + 8);
+		if (ReadLE(source + 4) == 0 || count > (size - HeaderSize) / 8)
+			return 0;
+
+		TileSize = ReadLE(source + 4);
+		Ranges.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			Ranges[i] = ReadRange(source + HeaderSize + i * 8);
+		return HeaderSize + (size_t)count * 8;
+	}
+
+	bool TileRanges::Covers(uint32_t width, uint32_t height) const
+	{
+		return TileSize > 0 && Ranges.size() == GetTileCount(width, height, TileSize);
+	}
+
+	void TileGrid::Write(std::vector<uint8_t>& dest) const
+	{
+		dest.resize(HeaderSize + Tiles.size() * TileHeader::Size);
+		memcpy(dest.data(), "dstg", 4);
+		WriteLE(dest.data() + 4, TileSize);
+		WriteLE(dest.data() + 8, (uint32_t)Tiles.size());
+
+		std::vector<uint8_t> tile;
+		for (size_t i = 0; i < Tiles.size(); i++)
+		{
+			Tiles[i].Write(tile);
+			memcpy(dest.data() + HeaderSize + i * TileHeader::Size, tile.data(), TileHeader::Size);
+		}
+	}
+
+	size_t TileGrid::Read(const uint8_t* source, size_t size)
+	{
+		if (size < HeaderSize || memcmp(source, "dstg", 4) != 0)
+			return 0;
+
+		uint32_t count = ReadLE(source + 8);
+		if (ReadLE(source + 4) == 0 || count > (size - HeaderSize) / TileHeader::Size)
+			return 0;
+
+		TileSize = ReadLE(source + 4);
+		Tiles.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			if (!Tiles[i].Read(source + HeaderSize + i * TileHeader::Size, TileHeader::Size))
+				return 0;
+		return HeaderSize + (size_t)count * TileHeader::Size;
+	}
+
+	bool TileGrid::Covers(uint32_t width, uint32_t height) const
+	{
+		return TileSize > 0 && Tiles.size() == GetTileCount(width, height, TileSize);
+	}
+
+	const char* TileHeader::GetCoderName(CoderType coder)
+	{
+		static const char* names[] = { "Packed2", "Packed3", "Split2", "Split3", "Hilbert", "Morton", "Hue", "Triangle", "Phase" };
+		return coder < CoderType::Count ? names[(uint8_t)coder] : "Unknown";
+	}
+}
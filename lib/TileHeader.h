@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DepthProcessing.h>
+
+namespace DStream
+{
+	enum class CoderType : uint8_t { Packed2 = 0, Packed3, Split2, Split3, Hilbert, Morton, Hue, Triangle, Phase, Count };
+
+	// Coder and parameters used for a tile, stored next to its encoded image so that the decoder can build the same
+	// StreamCoder and go back to depth. Serialized as "dstl", coder, algoBits, flags (bit 0 enlarge, bit 1 interpolate),
+	// quality, range offset and scale (little endian floats)
+	struct TileHeader
+	{
+		CoderType Coder = CoderType::Hilbert;
+		uint8_t AlgoBits = 8;
+		bool Enlarge = true;
+		bool Interpolate = true;
+		// Image quality the tile has been encoded with, 0 if lossless or unknown
+		uint8_t Quality = 0;
+		// Depth range of the quantized values, the default one leaves them as they are
+		DepthRange Range;
+
+		TileHeader() = default;
+		TileHeader(CoderType coder, uint8_t algoBits, bool enlarge = true, bool interpolate = true)
+			: Coder(coder), AlgoBits(algoBits), Enlarge(enlarge), Interpolate(interpolate) {}
+
+		void Write(std::vector<uint8_t>& dest) const;
+		bool Read(const uint8_t* source, size_t size);
+
+		static const char* GetCoderName(CoderType coder);
+
+		static const uint32_t Size = 16;
+	};
+
+	// Ranges of a frame quantized in tiles, see DepthProcessing::QuantizeTiled. Serialized as "dstr", tile size and
+	// number of tiles (little endian uint32), offset and scale of every tile (little endian floats)
+	struct TileRanges
+	{
+		uint32_t TileSize = 0;
+		std::vector<DepthRange> Ranges;
+
+		void Write(std::vector<uint8_t>& dest) const;
+		// Returns the number of bytes read, 0 on error
+		size_t Read(const uint8_t* source, size_t size);
+		// True if there's one range for every tile of a width x height frame
+		bool Covers(uint32_t width, uint32_t height) const;
+
+		static const uint32_t HeaderSize = 12;
+	};
+
+	// Headers of a frame whose tiles have been coded with their own coder, see Autotuner and TiledCoder. Serialized as
+	// "dstg", tile size and number of tiles (little endian uint32), followed by the TileHeader of every tile in row order
+	struct TileGrid
+	{
+		uint32_t TileSize = 0;
+		std::vector<TileHeader> Tiles;
+
+		void Write(std::vector<uint8_t>& dest) const;
+		// Returns the number of bytes read, 0 on error
+		size_t Read(const uint8_t* source, size_t size);
+		// True if there's one header for every tile of a width x height frame
+		bool Covers(uint32_t width, uint32_t height) const;
+
+		static const uint32_t HeaderSize = 12;
+	};
+}